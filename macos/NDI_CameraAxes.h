@@ -0,0 +1,109 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Every PTZ axis the CHOP controls, described once: its parameter, its
+ *    output channel, where it's kept and which command carries it to the camera.
+ *    Parameters, change detection and channel names are all generated from here.
+ */
+
+#pragma once
+
+#include "NDI_CommandQueue.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NDI_AXES_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NDI_AXES_NEON
+#endif
+
+// Packed so two snapshots compare two axes per vector. Left at the default
+// alignment, instances are made with plain new, and unaligned loads cost
+// nothing on the CPUs we run on.
+struct CameraData {
+    double abs_pan;
+    double abs_tilt;
+    double abs_zoom;
+    double abs_focus;
+
+    double speed_pan;
+    double speed_tilt;
+    double speed_zoom;
+    double speed_focus;
+
+    double gain;
+    double iris;
+    double shutter_speed;
+};
+
+struct AxisDescriptor {
+    const char* par_name;
+    const char* par_label;
+    const char* channel_name;
+
+    double default_value;
+    double min_slider;
+    double max_slider;
+
+    double CameraData::* field;
+    PTZCommandType command;
+    float PTZCommand::* argument;    // where the value goes in the command
+};
+
+// In parameter and output channel order
+constexpr AxisDescriptor CameraAxes[] = {
+    { "Abspan", "Absolute Pan", "abs_pan", 0., -1., 1., &CameraData::abs_pan, PTZCommandType::PanTilt, &PTZCommand::a },
+    { "Abstilt", "Absolute Tilt", "abs_tilt", 0., -1., 1., &CameraData::abs_tilt, PTZCommandType::PanTilt, &PTZCommand::b },
+    { "Abszoom", "Absolute Zoom", "abs_zoom", 0., 0., 1., &CameraData::abs_zoom, PTZCommandType::Zoom, &PTZCommand::a },
+    { "Absfocus", "Absolute Focus", "abs_focus", 0., 0., 1., &CameraData::abs_focus, PTZCommandType::Focus, &PTZCommand::a },
+
+    { "Speedpan", "Pan Speed", "speed_pan", 0., -1., 1., &CameraData::speed_pan, PTZCommandType::PanTiltSpeed, &PTZCommand::a },
+    { "Speedtilt", "Tilt Speed", "speed_tilt", 0., -1., 1., &CameraData::speed_tilt, PTZCommandType::PanTiltSpeed, &PTZCommand::b },
+    { "Speedzoom", "Zoom Speed", "speed_zoom", 0., -1., 1., &CameraData::speed_zoom, PTZCommandType::ZoomSpeed, &PTZCommand::a },
+    { "Speedfocus", "Focus Speed", "speed_focus", 0., -1., 1., &CameraData::speed_focus, PTZCommandType::FocusSpeed, &PTZCommand::a },
+
+    { "Gain", "Gain", "gain", 0., 0., 1., &CameraData::gain, PTZCommandType::ExposureManual, &PTZCommand::b },
+    { "Iris", "Iris", "iris", 0., 0., 1., &CameraData::iris, PTZCommandType::ExposureManual, &PTZCommand::a },
+    { "Shutterspeed", "Shutter Speed", "shutter_speed", 0., 0., 1., &CameraData::shutter_speed, PTZCommandType::ExposureManual, &PTZCommand::c },
+};
+
+constexpr int NumCameraAxes = sizeof(CameraAxes) / sizeof(CameraAxes[0]);
+
+static_assert(NumCameraAxes * sizeof(double) == sizeof(CameraData), "Every CameraData field needs an axis");
+
+// Bit i is set when axis i differs between the snapshots. Compares bit
+// patterns, so a NaN parameter doesn't count as a change on every cook.
+inline uint32_t ChangedAxes(const CameraData& previous, const CameraData& current) {
+    // Axes left over past the whole vectors are compared one by one
+    const int num_vectors = sizeof(CameraData) / 16;
+    const unsigned char* a = (const unsigned char*)&previous;
+    const unsigned char* b = (const unsigned char*)&current;
+    uint32_t changed = 0;
+#if defined(NDI_AXES_SSE2)
+    for (int i = 0; i < num_vectors; i++) {
+        const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i * 16)), _mm_loadu_si128((const __m128i*)(b + i * 16)));
+        const int bytes = _mm_movemask_epi8(equal);
+        changed |= (uint32_t)((bytes & 0x00FF) != 0x00FF) << (i * 2);
+        changed |= (uint32_t)((bytes & 0xFF00) != 0xFF00) << (i * 2 + 1);
+    }
+#elif defined(NDI_AXES_NEON)
+    for (int i = 0; i < num_vectors; i++) {
+        const uint64x2_t equal = vceqq_u64(vld1q_u64((const uint64_t*)(a + i * 16)), vld1q_u64((const uint64_t*)(b + i * 16)));
+        changed |= (uint32_t)(vgetq_lane_u64(equal, 0) == 0) << (i * 2);
+        changed |= (uint32_t)(vgetq_lane_u64(equal, 1) == 0) << (i * 2 + 1);
+    }
+#else
+    if (memcmp(a, b, sizeof(CameraData)) == 0) {
+        return 0;
+    }
+    for (int i = 0; i < num_vectors * 2; i++) {
+        changed |= (uint32_t)(memcmp(a + i * 8, b + i * 8, 8) != 0) << i;
+    }
+#endif
+    for (int i = num_vectors * 2; i < NumCameraAxes; i++) {
+        changed |= (uint32_t)(memcmp(a + i * 8, b + i * 8, 8) != 0) << i;
+    }
+    return changed;
+}
@@ -19,16 +19,18 @@
 
 #include "NDI_CameraControl_CHOP.h"
 
+#include <cstddef>
+
+// Instances are made with plain new, which before C++17 ignores any
+// alignment above the default one
+static_assert(alignof(NDI_CameraControl_CHOP) <= alignof(std::max_align_t), "NDI_CameraControl_CHOP must not be over-aligned");
+// So are bank cameras, each holding a sender and its queues
+static_assert(alignof(BankCamera) <= alignof(std::max_align_t), "BankCamera must not be over-aligned");
+
 extern "C"
 {
 DLLEXPORT
 
-NDIlib_v3* pNDILib;
-const NDIlib_source_t* p_sources;
-NDIlib_find_instance_t pNDI_find;
-NDIlib_recv_create_v3_t NDI_recv_create_desc;
-NDIlib_recv_instance_t pNDI_recv;
-
 void
 FillCHOPPluginInfo(TD::CHOP_PluginInfo* info)
 {
@@ -48,7 +50,7 @@ FillCHOPPluginInfo(TD::CHOP_PluginInfo* info)
     info->customOPInfo.authorEmail->setString("kostya29erohin@gmail.com");
     
     info->customOPInfo.minInputs = 0;
-    info->customOPInfo.maxInputs = 0;
+    info->customOPInfo.maxInputs = 1;
 }
 
 DLLEXPORT
@@ -72,65 +74,243 @@ DestroyCHOPInstance(TD::CHOP_CPlusPlusBase* instance)
 
 };
 
-// Camera PTZ values will be initialized after first &::execute run
-NDI_CameraControl_CHOP::NDI_CameraControl_CHOP(const TD::OP_NodeInfo* info) : myNodeInfo(info)
+// FNV-1a, plenty to tell source URLs apart
+static uint64_t HashSourceURL(const char* url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* c = url ? url : ""; *c; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// How long after startup the first instance waits for discovery to find
+// something to put in its source menu, which only Re-Init builds again
+static const std::chrono::seconds first_sources_wait(1);
+
+// Status channels follow the axes in every camera's output group
+static const char* const StatusChannelNames[] = {
+    "connection_state", "connect_latency",
+    "actual_pan", "actual_tilt", "actual_zoom", "actual_focus",
+};
+static const int NumStatusChannels = sizeof(StatusChannelNames) / sizeof(StatusChannelNames[0]);
+static const int NumOutputChannels = NumCameraAxes + NumStatusChannels;
+
+static const char* GetOutputChannelName(int index) {
+    return index < NumCameraAxes ? CameraAxes[index].channel_name : StatusChannelNames[index - NumCameraAxes];
+}
+
+static_assert(NumCameraAxes + NumOtherEnablePars <= 32, "Enable state bits must fit a uint32_t");
+
+static uint32_t EnableBit(EnablePar par) {
+    return 1u << (NumCameraAxes + (int)par);
+}
+
+// Parameter of an enable state bit. By name, not position, so adding
+// parameters can't shift them.
+static const char* GetEnableParName(int bit) {
+    if (bit < NumCameraAxes) {
+        return CameraAxes[bit].par_name;
+    }
+    switch ((EnablePar)(bit - NumCameraAxes)) {
+    case EnablePar::AvailableSources: return "Availablesources";
+    case EnablePar::PidGains: return "Pidgains";
+    case EnablePar::MaxVelocity: return "Maxvelocity";
+    case EnablePar::MaxAccel: return "Maxaccel";
+    case EnablePar::MaxJerk: return "Maxjerk";
+    case EnablePar::ControlRate: return "Controlrate";
+    case EnablePar::KeepaliveRate: return "Keepaliverate";
+    case EnablePar::DeadmanTimeout: return "Deadmantimeout";
+    }
+    return nullptr;
+}
+
+// Info CHOP channels, the counters first
+enum class InfoChannel : int {
+    ExecuteCount,
+    CommandsSubmitted,
+    CommandsSent,
+    CommandsConflated,
+    CommandsDropped,
+    CommandsBlocked,
+    Reconnects,
+    SourceGeneration,
+    CommandsThrottled,
+    CommandRate,
+    CommandLatency,
+    PtzFrames,
+    DeadmanStops,
+    CookTimeLast,
+    CookTimeAverage,
+    CookTimeMax,
+    QueueDepth,
+    ConnectLatency,
+    FeedbackAge,
+};
+static const int NumCounterChannels = (int)InfoChannel::FeedbackAge + 1;
+
+// Then commands sent per second by type
+static const char* const SendRateChannelNames[] = {
+    "sentPerSecondPanTilt", "sentPerSecondPanTiltSpeed", "sentPerSecondZoom", "sentPerSecondZoomSpeed",
+    "sentPerSecondFocus", "sentPerSecondFocusSpeed", "sentPerSecondExposure", "sentPerSecondPreset",
+};
+static_assert(sizeof(SendRateChannelNames) / sizeof(SendRateChannelNames[0]) == NumPTZCommandTypes, "One send rate channel per command type");
+static const int FirstSendRateChannel = NumCounterChannels;
+
+// Then the command to feedback latency, in milliseconds
+static const char* const FeedbackLatencyChannelNames[] = {
+    "feedbackLatencyP50", "feedbackLatencyP95", "feedbackLatencyP99", "feedbackLatencyMax", "feedbackLatencySamples",
+};
+static const int FirstFeedbackLatencyChannel = FirstSendRateChannel + NumPTZCommandTypes;
+static const int NumFeedbackLatencyChannels = sizeof(FeedbackLatencyChannelNames) / sizeof(FeedbackLatencyChannelNames[0]);
+
+// Info DAT rows before the ones per camera
+static const int NumInfoDATRows = 4;
+// Then the feedback latency of the camera, and a connection state and
+// feedback latency per bank camera
+static const int InfoDATRowsPerCamera = 2;
+
+static void FormatLatency(const LatencySummary& summary, char* buffer, size_t size) {
+    if (summary.count == 0) {
+#ifdef _WIN32
+        sprintf_s(buffer, size, "none");
+#else // macOS
+        snprintf(buffer, size, "none");
+#endif
+        return;
+    }
+#ifdef _WIN32
+    sprintf_s(buffer, size, "p50 %.1f p95 %.1f p99 %.1f max %.1f ms, %llu samples",
+        summary.p50, summary.p95, summary.p99, summary.max, (unsigned long long)summary.count);
+#else // macOS
+    snprintf(buffer, size, "p50 %.1f p95 %.1f p99 %.1f max %.1f ms, %llu samples",
+        summary.p50, summary.p95, summary.p99, summary.max, (unsigned long long)summary.count);
+#endif
+}
+
+// Times a cook until it goes out of scope, whichever way execute() returns
+class CookTimeScope
 {
-    myExecuteCount = 0;
-    myOffset = 0.0;
-    
-    std::string ndi_path = "/usr/local/lib/libndi.dylib";
-    
-    
-    void *hNDILib = ::dlopen(ndi_path.c_str(), RTLD_LOCAL | RTLD_LAZY);
-    
-    // The main NDI entry point for dynamic loading if we got the library
-    NDIlib_v3* (*NDIlib_v3_load)(void) = NULL;
-    if (hNDILib)
-        *((void**)&NDIlib_v3_load) = ::dlsym(hNDILib, "NDIlib_v3_load");
-    
-    if (!NDIlib_v3_load)
-    {
-        printf("Please re-install the NewTek NDI Runtimes to use this application.");
+public:
+    explicit CookTimeScope(CookTime& cook_time) : cook_time(cook_time), start(std::chrono::steady_clock::now()) {}
+    ~CookTimeScope() {
+        cook_time.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+    CookTime& cook_time;
+    const std::chrono::steady_clock::time_point start;
+};
+
+void CookTime::Record(int64_t ns) {
+    last_ns = ns;
+    // Exponential, over roughly the last hundred cooks
+    average_ns = average_ns == 0.0 ? (double)ns : average_ns + ((double)ns - average_ns) / 100.0;
+    max_ns = std::max(max_ns, ns);
+}
+
+// Fills the status channels of one camera, channels points at the first of them
+static void WriteStatusChannels(float** channels, CameraConnection& connection) {
+    const CameraPosition position = connection.GetPosition();
+    channels[0][0] = (float)connection.GetState();
+    channels[1][0] = (float)connection.GetConnectLatency();
+    channels[2][0] = (float)position.pan;
+    channels[3][0] = (float)position.tilt;
+    channels[4][0] = (float)position.zoom;
+    channels[5][0] = (float)position.focus;
+}
+
+// Makes the next SubmitChanges send these commands whatever their values
+static void ForgetSent(CameraData& current, uint32_t commands) {
+    for (const AxisDescriptor& axis : CameraAxes) {
+        if (commands & (1u << (int)axis.command)) {
+            current.*axis.field = NAN;
+        }
+    }
+}
+
+// Bank mode is on while the Bank Sources DAT has rows. Null otherwise.
+static const TD::OP_DATInput* GetBankSources(const TD::OP_Inputs* inputs) {
+    const TD::OP_DATInput* sources_dat = inputs->getParDAT("Banksources");
+    return sources_dat && sources_dat->numRows > 0 && sources_dat->numCols > 0 ? sources_dat : nullptr;
+}
+
+// Value of a channel at a fractional sample position. Down to -1, before
+// the slice, it runs on from the previous slice's last sample, tail, or
+// holds the first if there was none.
+static double SampleInput(const float* data, int last, double tail, double phase) {
+    if (phase < 0.0) {
+        return std::isnan(tail) ? data[0] : tail + (data[0] - tail) * (phase + 1.0);
+    }
+    const int i0 = (int)phase;
+    const int i1 = std::min(i0 + 1, last);
+    return data[i0] + (data[i1] - data[i0]) * (phase - i0);
+}
+
+// Queues a command for every axis whose target differs from what the camera was last sent
+// Held commands aren't sent, their axes are only recorded.
+static void SubmitChanges(CameraData& current, const CameraData& target, CommandSender& sender, uint32_t held_commands,
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::time_point()) {
+    // The common case: nothing moved since the last cook
+    const uint32_t changed_axes = ChangedAxes(current, target);
+    if (changed_axes == 0) {
         return;
     }
     
-    // Lets get all of the DLL entry points
-    pNDILib = NDIlib_v3_load();
+    // Axes sharing a command are sent together when any of them changed
+    uint32_t dirty = 0;
+    for (int f = 0; f < NumCameraAxes; f++) {
+        if (changed_axes & (1u << f)) {
+            dirty |= 1u << (int)CameraAxes[f].command;
+        }
+    }
+    dirty &= ~held_commands;
     
-    // We can now run as usual
-    if (!pNDILib->initialize())
-    {    // Cannot run NDI. Most likely because the CPU is not sufficient (see SDK documentation).
-        // you can check this directly with a call to NDIlib_is_supported_CPU()
-        printf("Cannot run NDI\n");
-        if (!pNDILib->NDIlib_is_supported_CPU) {
-            printf("CPU is not supported\n");
+    PTZCommand commands[NumPTZCommandTypes];
+    for (int i = 0; i < NumPTZCommandTypes; i++) {
+        commands[i] = MakeCommand((PTZCommandType)i);
+    }
+    for (const AxisDescriptor& axis : CameraAxes) {
+        if (dirty & (1u << (int)axis.command)) {
+            commands[(int)axis.command].*axis.argument = (float)(target.*axis.field);
         }
-        
-    } else {
-        printf("NDI Initialization is succesfull\n");
     }
     
-    const NDIlib_find_create_t NDI_find_create_desc = { true, NULL };
+    for (int i = 0; i < NumPTZCommandTypes; i++) {
+        if (dirty & (1u << i)) {
+            sender.Submit(commands[i], due);
+        }
+    }
+    current = target;
+}
 
-    pNDI_find = pNDILib->NDIlib_find_create_v2(&NDI_find_create_desc);
+// Camera PTZ values will be initialized after first &::execute run
+NDI_CameraControl_CHOP::NDI_CameraControl_CHOP(const TD::OP_NodeInfo* info) : myNodeInfo(info), connection(ptz_sender),
+    position_controller(ptz_sender, connection)
+{
+    myExecuteCount = 0;
     
     memset(source_names, 0, sizeof(source_names));
     memset(source_ips, 0, sizeof(source_ips));
+    ResetInput();
     
-    if (!pNDILib->NDIlib_initialize()) {
-        // Cannot run NDI. Most likely because the CPU is not sufficient (see SDK
-        // documentation). you can check this directly with a call to
-        // NDIlib_is_supported_CPU()
-        printf("Cannot run NDI.\n");
-    }
-    UpdateSources();
+    // Loads and initialises NDI for the first instance, null if it isn't installed
+    ndi_runtime = NDIRuntime::Acquire();
+    pNDILib = ndi_runtime->GetLib();
+    
+    ptz_sender.Start(pNDILib);
+    connection.Start(ndi_runtime->GetReceivers(), pNDILib);
 }
 
 NDI_CameraControl_CHOP::~NDI_CameraControl_CHOP()
 {
-    pNDILib->NDIlib_recv_destroy(pNDI_recv);
-    pNDILib->NDIlib_find_destroy(pNDI_find);
-    pNDILib->NDIlib_destroy();
+    // Nothing may still be sending on the receiver once it's released,
+    // and every receiver has to be gone before NDI itself is torn down
+    position_controller.Stop();
+    connection.Stop();
+    ptz_sender.Stop();
+    bank_cameras.clear();
+    NDIRuntime::Release();
 }
 
 void
@@ -139,6 +319,10 @@ NDI_CameraControl_CHOP::getGeneralInfo(TD::CHOP_GeneralInfo* ginfo, const TD::OP
     // This will cause the node to cook every frame
     ginfo->cookEveryFrameIfAsked = true;
     
+    // Velocity mode's dead man is fed by the cooks, so they must keep coming
+    // even when nothing downstream asks for the output
+    ginfo->cookEveryFrame = inputs->getParInt("Absolutevalues") == 0;
+    
     // Note: To disable timeslicing you'll need to turn this off, as well as ensure that
     // getOutputInfo() returns true, and likely also set the info->numSamples to how many
     // samples you want to generate for this CHOP. Otherwise it'll take on length of the
@@ -152,7 +336,8 @@ bool
 NDI_CameraControl_CHOP::getOutputInfo(TD::CHOP_OutputInfo* info, const TD::OP_Inputs* inputs, void* reserved1)
 {
     {
-        info->numChannels = 24;
+        const TD::OP_DATInput* bank_sources = GetBankSources(inputs);
+        info->numChannels = bank_sources ? bank_sources->numRows * NumOutputChannels : NumOutputChannels;
         // Since we are outputting a timeslice, the system will dictate
         // the numSamples and startIndex of the CHOP data
         info->numSamples = 1;
@@ -167,20 +352,19 @@ NDI_CameraControl_CHOP::getOutputInfo(TD::CHOP_OutputInfo* info, const TD::OP_In
 void
 NDI_CameraControl_CHOP::getChannelName(int32_t index, TD::OP_String* name, const TD::OP_Inputs* inputs, void* reserved1)
 {
-    switch (index) {
-        case 0: {name->setString("abs_pan"); break; }
-        case 1: {name->setString("abs_tilt"); break; }
-        case 2: {name->setString("abs_zoom"); break; }
-        case 3: {name->setString("abs_focus"); break; }
-        case 4: {name->setString("speed_pan"); break; }
-        case 5: {name->setString("speed_tilt"); break; }
-        case 6: {name->setString("speed_zoom"); break; }
-        case 7: {name->setString("speed_focus"); break; }
-        case 8: {name->setString("gain"); break; }
-        case 9: {name->setString("iris"); break; }
-        case 10: {name->setString("shutter_speed"); break; }
-        default: {name->setString("unknown_channel"); break; }
+    // Banks output one group of channels per camera, e.g. cam3/abs_pan
+    if (GetBankSources(inputs)) {
+        char bank_name[64];
+#ifdef _WIN32
+        sprintf_s(bank_name, "cam%d/%s", index / NumOutputChannels + 1, GetOutputChannelName(index % NumOutputChannels));
+#else // macOS
+        snprintf(bank_name, sizeof(bank_name), "cam%d/%s", index / NumOutputChannels + 1, GetOutputChannelName(index % NumOutputChannels));
+#endif
+        name->setString(bank_name);
+        return;
     }
+    
+    name->setString(index < NumOutputChannels ? GetOutputChannelName(index) : "unknown_channel");
 }
 
 void
@@ -190,106 +374,127 @@ NDI_CameraControl_CHOP::execute(TD::CHOP_Output* output,
 {
     myExecuteCount++;
     
-//    inputs->enablePar("Absolutevalues", 1);
-    inputs->enablePar("Availablesources", 1);
+    CookTimeScope cook_scope(cook_time);
+    UpdateSendRates();
     
-    inputs->enablePar("Speedpan", 1);
-    inputs->enablePar("Speedtilt", 1);
-    inputs->enablePar("Speedzoom", 1);
-    inputs->enablePar("Speedfocus", 1);
+    const char* selected_id = inputs->getParString("Availablesources");
     
-    inputs->enablePar("Abspan", 1);
-    inputs->enablePar("Abstilt", 1);
-    inputs->enablePar("Abszoom", 1);
-    inputs->enablePar("Absfocus", 1);
+    ptz_sender.SetCommandRate(inputs->getParDouble("Commandrate"), inputs->getParDouble("Commandburst"), inputs->getParInt("Adaptiverate") != 0);
+    ptz_sender.SetBatching(inputs->getParInt("Batchcommands") != 0);
     
-    inputs->enablePar("Gain", 1);
-    inputs->enablePar("Iris", 1);
-    inputs->enablePar("Shutterspeed", 1);
+    bool receive_video_new = inputs->getParInt("Receivevideo") != 0;
     
-    const char* selected_id = inputs->getParString("Availablesources");
-    double abs_pan_new = inputs->getParDouble("Abspan");
-    double abs_tilt_new = inputs->getParDouble("Abstilt");
-    double abs_zoom_new = inputs->getParDouble("Abszoom");
-    double abs_focus_new = inputs->getParDouble("Absfocus");
+    const TD::OP_DATInput* bank_sources = GetBankSources(inputs);
+    if ((bank_sources != nullptr) != bank_mode) {
+        bank_mode = bank_sources != nullptr;
+        if (bank_mode) {
+            // The camera picked on the parameters page sits out while a bank is driven
+            position_controller.Stop();
+            connection.Disconnect();
+        }
+        else {
+            ResizeBank(0);
+        }
+        // Forces the single camera to reconnect once the bank is gone
+        selected_hash = 0;
+    }
+    
+    // Velocity mode: the speeds drive the heads and the absolute values sit
+    // out. Back in absolute mode they're sent again, the heads have moved.
+    const bool velocity_mode_new = inputs->getParInt("Absolutevalues") == 0;
+    if (velocity_mode_new != velocity_mode) {
+        velocity_mode = velocity_mode_new;
+        if (!velocity_mode) {
+            ForgetSent(cam_data, AbsoluteCommands);
+            for (CameraData& data : bank_data) {
+                ForgetSent(data, AbsoluteCommands);
+            }
+        }
+    }
+    
+    // Speeds are sent again while the cooks keep coming, and stopped when they don't
+    keepalive.enabled = velocity_mode;
+    keepalive.rate = inputs->getParDouble("Keepaliverate");
+    keepalive.timeout = inputs->getParDouble("Deadmantimeout");
+    ptz_sender.SetKeepalive(keepalive);
     
-    double speed_pan_new = inputs->getParDouble("Speedpan");
-    double speed_tilt_new = inputs->getParDouble("Speedtilt");
-    double speed_zoom_new = inputs->getParDouble("Speedzoom");
-    double speed_focus_new = inputs->getParDouble("Speedfocus");
+    // Stop All keeps the control loops off until Closed Loop is switched on again.
+    // Closed loop steers to the absolute values, so it's off in velocity mode too.
+    const bool closed_loop_par = inputs->getParInt("Closedloop") != 0;
+    if (!closed_loop_par) {
+        closed_loop_halted = false;
+    }
+    const bool closed_loop_new = closed_loop_par && !closed_loop_halted && !velocity_mode;
+    if (closed_loop_new != closed_loop) {
+        closed_loop = closed_loop_new;
+        if (!closed_loop) {
+            StopClosedLoop();
+        }
+    }
+    preset = inputs->getParInt("Preset");
+    preset_speed = inputs->getParDouble("Presetspeed");
+    
+    pid_gains.kp = inputs->getParDouble("Pidgains", 0);
+    pid_gains.ki = inputs->getParDouble("Pidgains", 1);
+    pid_gains.kd = inputs->getParDouble("Pidgains", 2);
     
-    double gain_new = inputs->getParDouble("Gain");
-    double iris_new = inputs->getParDouble("Iris");
-    double shutter_speed_new = inputs->getParDouble("Shutterspeed");
+    smoothing.enabled = inputs->getParInt("Smoothmoves") != 0;
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        smoothing.limits[i].velocity = inputs->getParDouble("Maxvelocity", i);
+        smoothing.limits[i].acceleration = inputs->getParDouble("Maxaccel", i);
+        smoothing.limits[i].jerk = inputs->getParDouble("Maxjerk", i);
+    }
+    ptz_sender.SetTrajectory(smoothing);
     
-//    int current_mode = inputs->getParInt("Absolutevalues");
+    // Closed loop and smooth moves run on their own clock, cooks only feed them targets
+    const double control_rate = inputs->getParDouble("Controlrate");
+    ptz_sender.SetControlRate(control_rate);
+    position_controller.SetControlRate(control_rate);
     
-    if ((char*)selected_id != selected_id_old) {
-        selected_id_old = (char*)selected_id;
-        this->ConnectByURL(selected_id);
+    UpdateEnabledPars(inputs);
+    
+    if (bank_mode) {
+        ExecuteBank(output, inputs, bank_sources, receive_video_new);
+        return;
+    }
+    
+    const uint64_t selected_hash_new = HashSourceURL(selected_id);
+    if (selected_hash_new != selected_hash || receive_video_new != receive_video) {
+        selected_hash = selected_hash_new;
+        receive_video = receive_video_new;
+        selection_generation++;
         printf("Selected source changed\n");
-        printf("Connecting to camera at %s\n", selected_id);
+        this->ConnectByURL(selected_id);
     }
     
     {
-        // Speed Values
-        {
-            if (cam_data.speed_pan != speed_pan_new || cam_data.speed_tilt != speed_tilt_new) {
-                cam_data.speed_pan = speed_pan_new;
-                cam_data.speed_tilt = speed_tilt_new;
-                pNDILib->NDIlib_recv_ptz_pan_tilt_speed(pNDI_recv, cam_data.speed_pan, cam_data.speed_tilt);
-            }
-            
-            if (cam_data.speed_zoom != inputs->getParDouble("Speedzoom")) {
-                cam_data.speed_zoom = speed_zoom_new;
-                pNDILib->NDIlib_recv_ptz_zoom_speed(pNDI_recv, cam_data.speed_zoom);
-            }
-            
-            if (cam_data.speed_focus != inputs->getParDouble("Speedfocus")) {
-                cam_data.speed_focus = speed_focus_new;
-                pNDILib->NDIlib_recv_ptz_focus_speed(pNDI_recv, cam_data.speed_focus);
-            }
+        // Parameters first, an input CHOP overrides the axes it has channels for.
+        // One lookup per parameter, straight into place.
+        CameraData target = {};
+        for (const AxisDescriptor& axis : CameraAxes) {
+            target.*axis.field = inputs->getParDouble(axis.par_name);
         }
         
-        // Absolute values
-        {
-            if (cam_data.abs_pan != abs_pan_new || cam_data.abs_tilt != abs_tilt_new) {
-                cam_data.abs_pan = abs_pan_new;
-                cam_data.abs_tilt = abs_tilt_new;
-                pNDILib->NDIlib_recv_ptz_pan_tilt(pNDI_recv, cam_data.abs_pan, cam_data.abs_tilt);
-            }
-            if (cam_data.abs_zoom != inputs->getParDouble("Abszoom")) {
-                cam_data.abs_zoom = abs_zoom_new;
-                pNDILib->NDIlib_recv_ptz_zoom(pNDI_recv, cam_data.abs_zoom);
-            }
-            if (cam_data.abs_focus != inputs->getParDouble("Absfocus")) {
-                cam_data.abs_focus = abs_focus_new;
-                pNDILib->NDIlib_recv_ptz_focus(pNDI_recv, cam_data.abs_focus);
-            }
+        const TD::OP_CHOPInput* input = inputs->getNumInputs() > 0 ? inputs->getInputCHOP(0) : nullptr;
+        if (input) {
+            ConsumeInput(input, target, inputs->getParDouble("Commandrate"));
         }
-        
-        // Exposure values
-        {
-            if (cam_data.iris != iris_new || cam_data.gain != gain_new || cam_data.shutter_speed != shutter_speed_new) {
-                cam_data.gain = gain_new;
-                cam_data.iris = iris_new;
-                cam_data.shutter_speed = shutter_speed_new;
-                pNDILib->NDIlib_recv_ptz_exposure_manual_v2(pNDI_recv, cam_data.iris, cam_data.gain, cam_data.shutter_speed);
-            }
+        else {
+            ResetInput();
+            SubmitChanges(cam_data, target, ptz_sender, GetHeldCommands(), GetParameterDue());
         }
+        ptz_sender.Feed(SpeedCommands);
         
-        output->channels[0][0] = cam_data.abs_pan;
-        output->channels[1][0] = cam_data.abs_tilt;
-        output->channels[2][0] = cam_data.abs_zoom;
-        output->channels[3][0] = cam_data.abs_focus;
-        output->channels[4][0] = cam_data.speed_pan;
-        output->channels[5][0] = cam_data.speed_tilt;
-        output->channels[6][0] = cam_data.speed_zoom;
-        output->channels[7][0] = cam_data.speed_focus;
-        output->channels[8][0] = cam_data.gain;
-        output->channels[9][0] = cam_data.iris;
-        output->channels[10][0] = cam_data.shutter_speed;
+        if (closed_loop) {
+            position_controller.SetTarget(cam_data.abs_pan, cam_data.abs_tilt, cam_data.abs_zoom, pid_gains);
+            position_controller.Start();
+        }
         
+        for (int f = 0; f < NumCameraAxes; f++) {
+            output->channels[f][0] = (float)(cam_data.*CameraAxes[f].field);
+        }
+        WriteStatusChannels(output->channels + NumCameraAxes, connection);
+                
     }
     
 }
@@ -299,8 +504,8 @@ int32_t
 NDI_CameraControl_CHOP::getNumInfoCHOPChans(void* reserved1)
 {
     // We return the number of channel we want to output to any Info CHOP
-    // connected to the CHOP. In this example we are just going to send one channel.
-    return 1;
+    // connected to the CHOP.
+    return FirstFeedbackLatencyChannel + NumFeedbackLatencyChannels;
 }
 
 void
@@ -309,25 +514,202 @@ NDI_CameraControl_CHOP::getInfoCHOPChan(int32_t index,
                                         void* reserved1)
 {
     // This function will be called once for each channel we said we'd want to return
-    // In this example it'll only be called once.
     
-    if (index == 0)
+    if (index == (int)InfoChannel::ExecuteCount)
     {
         chan->name->setString("executeCount");
         chan->value = (float)myExecuteCount;
     }
     
-    if (index == 1)
+    // Commands handed to the sender vs. what actually went out to the camera.
+    // Conflated ones were replaced by a newer value for the same axis before
+    // they were sent, dropped ones didn't fit in the queue.
+    if (index == (int)InfoChannel::CommandsSubmitted)
+    {
+        chan->name->setString("commandsSubmitted");
+        chan->value = (float)SumSenders(&CommandSender::GetSubmittedCount);
+    }
+    
+    if (index == (int)InfoChannel::CommandsSent)
+    {
+        chan->name->setString("commandsSent");
+        chan->value = (float)SumSenders(&CommandSender::GetSentCount);
+    }
+    
+    if (index == (int)InfoChannel::CommandsConflated)
+    {
+        chan->name->setString("commandsConflated");
+        chan->value = (float)SumSenders(&CommandSender::GetConflatedCount);
+    }
+    
+    if (index == (int)InfoChannel::CommandsDropped)
+    {
+        chan->name->setString("commandsDropped");
+        chan->value = (float)SumSenders(&CommandSender::GetDroppedCount);
+    }
+    
+    // Not sent because another instance on the same camera has control
+    if (index == (int)InfoChannel::CommandsBlocked)
+    {
+        chan->name->setString("commandsBlocked");
+        chan->value = (float)SumSenders(&CommandSender::GetBlockedCount);
+    }
+    
+    if (index == (int)InfoChannel::Reconnects)
     {
-        chan->name->setString("offset");
-        chan->value = (float)myOffset;
+        uint64_t reconnects = connection.GetReconnectCount();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            reconnects += camera->connection.GetReconnectCount();
+        }
+        chan->name->setString("reconnects");
+        chan->value = (float)reconnects;
+    }
+    
+    // Goes up once per real change of the selected source
+    if (index == (int)InfoChannel::SourceGeneration)
+    {
+        chan->name->setString("sourceGeneration");
+        chan->value = (float)selection_generation;
+    }
+    
+    // Held back because the camera's command budget was used up
+    if (index == (int)InfoChannel::CommandsThrottled)
+    {
+        chan->name->setString("commandsThrottled");
+        chan->value = (float)SumSenders(&CommandSender::GetThrottledCount);
+    }
+    
+    // Commands per second the camera is paced at, the slowest camera's in
+    // bank mode. With Adaptive Rate on, this is what the camera keeps up with.
+    if (index == (int)InfoChannel::CommandRate)
+    {
+        double rate = ptz_sender.GetPacedRate();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            const double camera_rate = camera->sender.GetPacedRate();
+            if (camera_rate > 0.0 && (rate <= 0.0 || camera_rate < rate)) {
+                rate = camera_rate;
+            }
+        }
+        chan->name->setString("commandRate");
+        chan->value = (float)rate;
+    }
+    
+    // The adaptive rate's smoothed feedback latency in milliseconds, the
+    // slowest camera's in bank mode. Measured with Adaptive Rate on.
+    if (index == (int)InfoChannel::CommandLatency)
+    {
+        double latency = ptz_sender.GetCommandLatency();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            latency = std::max(latency, camera->sender.GetCommandLatency());
+        }
+        chan->name->setString("commandLatency");
+        chan->value = (float)(latency * 1000.0);
+    }
+    
+    // Metadata frames the sent commands went out in. Fewer than commandsSent
+    // while Batch Commands packs several axes into one.
+    if (index == (int)InfoChannel::PtzFrames)
+    {
+        chan->name->setString("ptzFrames");
+        chan->value = (float)SumSenders(&CommandSender::GetFrameCount);
+    }
+    
+    // Axes velocity mode stopped because the cooks stopped coming
+    if (index == (int)InfoChannel::DeadmanStops)
+    {
+        chan->name->setString("deadmanStops");
+        chan->value = (float)SumSenders(&CommandSender::GetDeadmanStopCount);
+    }
+    
+    // How long execute() takes, in nanoseconds
+    if (index == (int)InfoChannel::CookTimeLast)
+    {
+        chan->name->setString("cookTimeLast");
+        chan->value = (float)cook_time.last_ns;
+    }
+    
+    if (index == (int)InfoChannel::CookTimeAverage)
+    {
+        chan->name->setString("cookTimeAverage");
+        chan->value = (float)cook_time.average_ns;
+    }
+    
+    if (index == (int)InfoChannel::CookTimeMax)
+    {
+        chan->name->setString("cookTimeMax");
+        chan->value = (float)cook_time.max_ns;
+    }
+    
+    // Commands waiting to be sent, over every camera
+    if (index == (int)InfoChannel::QueueDepth)
+    {
+        size_t depth = ptz_sender.GetQueueDepth();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            depth += camera->sender.GetQueueDepth();
+        }
+        chan->name->setString("queueDepth");
+        chan->value = (float)depth;
+    }
+    
+    // The slowest camera's last connect, in milliseconds
+    if (index == (int)InfoChannel::ConnectLatency)
+    {
+        double latency = connection.GetConnectLatency();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            latency = std::max(latency, camera->connection.GetConnectLatency());
+        }
+        chan->name->setString("connectLatency");
+        chan->value = (float)latency;
+    }
+    
+    // Milliseconds since the camera last reported its position, the stalest
+    // camera's in bank mode. -1 while none has reported.
+    if (index == (int)InfoChannel::FeedbackAge)
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double age = -1.0;
+        CameraPosition position = connection.GetPosition();
+        if (position.reports != 0) {
+            age = std::chrono::duration<double, std::milli>(now - position.reported_at).count();
+        }
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            position = camera->connection.GetPosition();
+            if (position.reports != 0) {
+                age = std::max(age, std::chrono::duration<double, std::milli>(now - position.reported_at).count());
+            }
+        }
+        chan->name->setString("feedbackAge");
+        chan->value = (float)age;
+    }
+    
+    if (index >= FirstSendRateChannel && index < FirstSendRateChannel + NumPTZCommandTypes)
+    {
+        chan->name->setString(SendRateChannelNames[index - FirstSendRateChannel]);
+        chan->value = (float)send_rates[index - FirstSendRateChannel];
+    }
+    
+    // The slowest camera's percentiles, every camera's samples
+    if (index >= FirstFeedbackLatencyChannel && index < FirstFeedbackLatencyChannel + NumFeedbackLatencyChannels)
+    {
+        LatencySummary summary = ptz_sender.GetFeedbackLatency();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            const LatencySummary bank_summary = camera->sender.GetFeedbackLatency();
+            summary.count += bank_summary.count;
+            summary.p50 = std::max(summary.p50, bank_summary.p50);
+            summary.p95 = std::max(summary.p95, bank_summary.p95);
+            summary.p99 = std::max(summary.p99, bank_summary.p99);
+            summary.max = std::max(summary.max, bank_summary.max);
+        }
+        const double values[] = { summary.p50, summary.p95, summary.p99, summary.max, (double)summary.count };
+        chan->name->setString(FeedbackLatencyChannelNames[index - FirstFeedbackLatencyChannel]);
+        chan->value = (float)values[index - FirstFeedbackLatencyChannel];
     }
 }
 
 bool
 NDI_CameraControl_CHOP::getInfoDATSize(TD::OP_InfoDATSize* infoSize, void* reserved1)
 {
-    infoSize->rows = 2;
+    infoSize->rows = NumInfoDATRows + 1 + InfoDATRowsPerCamera * (int32_t)bank_cameras.size();
     infoSize->cols = 2;
     // Setting this to false means we'll be assigning values to the table
     // one row at a time. True means we'll do it one column at a time.
@@ -360,16 +742,65 @@ NDI_CameraControl_CHOP::getInfoDATEntries(int32_t index,
     if (index == 1)
     {
         // Set the value for the first column
-        entries->values[0]->setString("offset");
+        entries->values[0]->setString("sourceCount");
+        
+        // Set the value for the second column
+#ifdef _WIN32
+        sprintf_s(tempBuffer, "%d", (int)ndi_runtime->GetDiscovery().GetSources()->size());
+#else // macOS
+        snprintf(tempBuffer, sizeof(tempBuffer), "%d", (int)ndi_runtime->GetDiscovery().GetSources()->size());
+#endif
+        entries->values[1]->setString(tempBuffer);
+    }
+    
+    if (index == 2)
+    {
+        // Milliseconds from startup until discovery saw the first source, -1 until then
+        entries->values[0]->setString("timeToFirstSource");
         
         // Set the value for the second column
 #ifdef _WIN32
-        sprintf_s(tempBuffer, "%g", myOffset);
+        sprintf_s(tempBuffer, "%g", ndi_runtime->GetDiscovery().GetTimeToFirstSource());
 #else // macOS
-        snprintf(tempBuffer, sizeof(tempBuffer), "%g", myOffset);
+        snprintf(tempBuffer, sizeof(tempBuffer), "%g", ndi_runtime->GetDiscovery().GetTimeToFirstSource());
 #endif
         entries->values[1]->setString(tempBuffer);
     }
+    
+    if (index == 3)
+    {
+        // Same as the connection_state channel, by name
+        entries->values[0]->setString("connectionState");
+        entries->values[1]->setString(GetConnectionStateName(connection.GetState()));
+    }
+    
+    if (index == NumInfoDATRows)
+    {
+        entries->values[0]->setString("feedbackLatency");
+        FormatLatency(ptz_sender.GetFeedbackLatency(), tempBuffer, sizeof(tempBuffer));
+        entries->values[1]->setString(tempBuffer);
+    }
+    
+    const int bank_row = index - NumInfoDATRows - 1;
+    const int bank_index = bank_row / InfoDATRowsPerCamera;
+    if (bank_row >= 0 && bank_index < (int)bank_cameras.size())
+    {
+        BankCamera& camera = *bank_cameras[bank_index];
+        const bool state_row = bank_row % InfoDATRowsPerCamera == 0;
+#ifdef _WIN32
+        sprintf_s(tempBuffer, "cam%d/%s", bank_index + 1, state_row ? "connectionState" : "feedbackLatency");
+#else // macOS
+        snprintf(tempBuffer, sizeof(tempBuffer), "cam%d/%s", bank_index + 1, state_row ? "connectionState" : "feedbackLatency");
+#endif
+        entries->values[0]->setString(tempBuffer);
+        if (state_row) {
+            entries->values[1]->setString(GetConnectionStateName(camera.connection.GetState()));
+        }
+        else {
+            FormatLatency(camera.sender.GetFeedbackLatency(), tempBuffer, sizeof(tempBuffer));
+            entries->values[1]->setString(tempBuffer);
+        }
+    }
 }
 
 
@@ -377,6 +808,9 @@ NDI_CameraControl_CHOP::getInfoDATEntries(int32_t index,
 void
 NDI_CameraControl_CHOP::setupParameters(TD::OP_ParameterManager* manager, void* reserved1)
 {
+    // Fresh parameters come up enabled, whatever we told the old ones
+    enabled_pars_pushed = false;
+    
     {
         TD::OP_StringParameter sp;
 
@@ -384,7 +818,12 @@ NDI_CameraControl_CHOP::setupParameters(TD::OP_ParameterManager* manager, void*
         sp.label = "Avalable Sources";
 
         sp.defaultValue = "None";
-
+        
+        // The menu is built from whatever discovery has found by now. Right
+        // after startup that's nothing yet, so give it a moment to find the first.
+        menu_sources = ndi_runtime->GetDiscovery().WaitForSources(first_sources_wait);
+        UpdateSources();
+        
         int num_of_sources = 0;
         for (int i = 0; source_names[i] != 0; i++) {
             num_of_sources++;
@@ -395,190 +834,369 @@ NDI_CameraControl_CHOP::setupParameters(TD::OP_ParameterManager* manager, void*
         TD::OP_ParAppendResult res = manager->appendStringMenu(sp, num_of_sources, source_ips, source_names);
         assert(res == TD::OP_ParAppendResult::Success);
     }
-    // ABSOLUTE VALUES MODE
+    // Absolute values <-> Value Change Speed MODE switch
     {
-        {
-            TD::OP_NumericParameter    np;
-            
-            np.name = "Abspan";
-            np.label = "Absolute Pan";
-            
-            np.defaultValues[0] = 0.0;
-            np.minSliders[0] = -1.0;
-            np.maxSliders[0] = 1.0;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        TD::OP_NumericParameter np;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Abstilt";
-            np.label = "Absolute Tilt";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = -1.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.name = "Absolutevalues";
+        np.label = "Absolute Values";
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Abszoom";
-            np.label = "Absolute Zoom";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = 0.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.defaultValues[0] = 1;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Absfocus";
-            np.label = "Absolute Focus";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = 0.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.page = "Camera Controls";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
     }
     
-    // SPEED VALUES MODE
-    {
-        {
-            TD::OP_NumericParameter    np;
-            
-            np.name = "Speedpan";
-            np.label = "Pan Speed";
-            
-            np.defaultValues[0] = 0.0;
-            np.minSliders[0] = -1.0;
-            np.maxSliders[0] = 1.0;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+    // PTZ AXES
+    // Absolute values, speeds and exposure, all generated from CameraAxes
+    for (const AxisDescriptor& axis : CameraAxes) {
+        TD::OP_NumericParameter np;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Speedtilt";
-            np.label = "Tilt Speed";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = -1.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.name = axis.par_name;
+        np.label = axis.par_label;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Speedzoom";
-            np.label = "Zoom Speed";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = -1.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.defaultValues[0] = axis.default_value;
+        np.minSliders[0] = axis.min_slider;
+        np.maxSliders[0] = axis.max_slider;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Speedfocus";
-            np.label = "Focus Speed";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = -1.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        np.page = "Camera Controls";
         
-        // EXPOSURE SETTINGS
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Gain";
-            np.label = "Gain";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = 0.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
-        }
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // PRESETS
+    {
+        TD::OP_NumericParameter np;
         
-        {
-            TD::OP_NumericParameter np;
-            
-            np.name = "Iris";
-            np.label = "Iris";
-            
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = 0.;
-            np.maxSliders[0] = 1.;
-            
-            np.page = "Camera Controls";
-            
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
-            assert(res == TD::OP_ParAppendResult::Success);
+        np.name = "Preset";
+        np.label = "Preset";
+        
+        np.defaultValues[0] = 0;
+        np.minValues[0] = 0;
+        np.maxValues[0] = 99;
+        np.clampMins[0] = true;
+        np.clampMaxes[0] = true;
+        np.minSliders[0] = 0;
+        np.maxSliders[0] = 99;
+        
+        np.page = "Camera Controls";
+        
+        TD::OP_ParAppendResult res = manager->appendInt(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Presetspeed";
+        np.label = "Preset Speed";
+        
+        np.defaultValues[0] = 1.;
+        np.minValues[0] = 0.;
+        np.maxValues[0] = 1.;
+        np.clampMins[0] = true;
+        np.clampMaxes[0] = true;
+        np.minSliders[0] = 0.;
+        np.maxSliders[0] = 1.;
+        
+        np.page = "Camera Controls";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Recallpreset";
+        np.label = "Recall Preset";
+        
+        np.page = "Camera Controls";
+        
+        TD::OP_ParAppendResult res = manager->appendPulse(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Halts every camera of this CHOP at once
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Stopall";
+        np.label = "Stop All";
+        
+        np.page = "Camera Controls";
+        
+        TD::OP_ParAppendResult res = manager->appendPulse(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // DISPATCH SETTINGS
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Commandrate";
+        np.label = "Command Rate";
+        
+        np.defaultValues[0] = 10.;
+        np.minValues[0] = 0.;
+        np.clampMins[0] = true;
+        np.minSliders[0] = 0.;
+        np.maxSliders[0] = 60.;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Commands the camera takes back to back before the rate applies
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Commandburst";
+        np.label = "Command Burst";
+        
+        np.defaultValues[0] = 1.;
+        np.minValues[0] = 1.;
+        np.clampMins[0] = true;
+        np.minSliders[0] = 1.;
+        np.maxSliders[0] = 20.;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Feed each camera as fast as its answers say it keeps up, Command Rate at most
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Adaptiverate";
+        np.label = "Adaptive Rate";
+        
+        np.defaultValues[0] = 0;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Pan, tilt, zoom and focus changed together go out in one metadata frame
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Batchcommands";
+        np.label = "Batch Commands";
+        
+        np.defaultValues[0] = 0;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // CLOSED LOOP
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Closedloop";
+        np.label = "Closed Loop";
+        
+        np.defaultValues[0] = 0;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Pidgains";
+        np.label = "PID Gains";
+        
+        const double gains[] = { 2.0, 0.5, 0.05 };
+        for (int i = 0; i < 3; i++) {
+            np.defaultValues[i] = gains[i];
+            np.minValues[i] = 0.;
+            np.clampMins[i] = true;
+            np.minSliders[i] = 0.;
+            np.maxSliders[i] = 5.;
         }
         
-        {
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np, 3);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // SMOOTH MOVES
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Smoothmoves";
+        np.label = "Smooth Moves";
+        
+        np.defaultValues[0] = 0;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Pan, tilt, zoom and focus limits of the moves
+    {
+        const char* names[] = { "Maxvelocity", "Maxaccel", "Maxjerk" };
+        const char* labels[] = { "Max Velocity", "Max Acceleration", "Max Jerk" };
+        const double defaults[] = { 1.0, 2.0, 8.0 };
+        
+        for (int p = 0; p < 3; p++) {
             TD::OP_NumericParameter np;
             
-            np.name = "Shutterspeed";
-            np.label = "Shutter Speed";
+            np.name = names[p];
+            np.label = labels[p];
             
-            np.defaultValues[0] = 0.;
-            np.minSliders[0] = 0.;
-            np.maxSliders[0] = 1.;
+            for (int i = 0; i < NumPlannedAxes; i++) {
+                np.defaultValues[i] = defaults[p];
+                np.minValues[i] = 0.01;
+                np.clampMins[i] = true;
+                np.minSliders[i] = 0.;
+                np.maxSliders[i] = defaults[p] * 4.;
+            }
             
-            np.page = "Camera Controls";
+            np.page = "Settings";
             
-            TD::OP_ParAppendResult res = manager->appendFloat(np);
+            TD::OP_ParAppendResult res = manager->appendFloat(np, NumPlannedAxes);
             assert(res == TD::OP_ParAppendResult::Success);
         }
     }
     
+    // Ticks per second of closed loop and smooth moves, independent of the cook rate
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Controlrate";
+        np.label = "Control Rate";
+        
+        np.defaultValues[0] = 50.;
+        np.minValues[0] = 10.;
+        np.maxValues[0] = 200.;
+        np.clampMins[0] = true;
+        np.clampMaxes[0] = true;
+        np.minSliders[0] = 10.;
+        np.maxSliders[0] = 200.;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // VELOCITY MODE
+    // Speeds are sent again this often, whether they changed or not
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Keepaliverate";
+        np.label = "Keepalive Rate";
+        
+        np.defaultValues[0] = 5.;
+        np.minValues[0] = 1.;
+        np.maxValues[0] = 50.;
+        np.clampMins[0] = true;
+        np.clampMaxes[0] = true;
+        np.minSliders[0] = 1.;
+        np.maxSliders[0] = 20.;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Seconds without a cook before the heads are stopped
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Deadmantimeout";
+        np.label = "Dead-man Timeout";
+        
+        np.defaultValues[0] = 0.5;
+        np.minValues[0] = 0.05;
+        np.clampMins[0] = true;
+        np.minSliders[0] = 0.1;
+        np.maxSliders[0] = 5.;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendFloat(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Video is only needed if something else wants to look at the stream,
+    // PTZ control works over a metadata-only connection
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Receivevideo";
+        np.label = "Receive Video";
+        
+        np.defaultValues[0] = 0;
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendToggle(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // BANK MODE
+    // Every row of this DAT is one camera, by source name or URL. Values come
+    // from channels of the Bank Values CHOP named like the outputs, e.g. cam3/abs_pan
+    {
+        TD::OP_StringParameter sp;
+        
+        sp.name = "Banksources";
+        sp.label = "Bank Sources";
+        
+        sp.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendDAT(sp);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    {
+        TD::OP_StringParameter sp;
+        
+        sp.name = "Bankvalues";
+        sp.label = "Bank Values";
+        
+        sp.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendCHOP(sp);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
+    // Starts the feedback latency percentiles over
+    {
+        TD::OP_NumericParameter np;
+        
+        np.name = "Resetlatency";
+        np.label = "Reset Latency";
+        
+        np.page = "Settings";
+        
+        TD::OP_ParAppendResult res = manager->appendPulse(np);
+        assert(res == TD::OP_ParAppendResult::Success);
+    }
+    
     // Update sources
     // Disabled since it's impossible to update GUI values without CHOP Re-Init
     //{
@@ -594,75 +1212,350 @@ NDI_CameraControl_CHOP::setupParameters(TD::OP_ParameterManager* manager, void*
     //    OP_ParAppendResult res = manager->appendPulse(np);
     //    assert(res == OP_ParAppendResult::Success);
     //}
-    
-    // Absolute values <-> Value Change Speed MODE switch
-    /*
-     {
-     OP_NumericParameter np;
-     
-     np.name = "Absolutevalues";
-     np.label = "Absolute Values";
-     
-     np.defaultValues[0] = 1;
-     
-     np.page = "Camera Controls";
-     
-     OP_ParAppendResult res = manager->appendToggle(np);
-     assert(res == OP_ParAppendResult::Success);
-     }
-     */
 }
 
 void
 NDI_CameraControl_CHOP::pulsePressed(const char* name, void* reserved1)
 {
-    if (!strcmp(name, "Updatesources")) {
-        UpdateSources();
+    if (!strcmp(name, "Stopall")) {
+        StopAll();
+    }
+    if (!strcmp(name, "Resetlatency")) {
+        ptz_sender.ResetFeedbackLatency();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            camera->sender.ResetFeedbackLatency();
+        }
+    }
+    if (!strcmp(name, "Recallpreset")) {
+        const PTZCommand command = MakeCommand(PTZCommandType::RecallPreset, (float)preset, (float)preset_speed);
+        ptz_sender.Submit(command);
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            camera->sender.Submit(command);
+        }
     }
 }
 
 void
 NDI_CameraControl_CHOP::UpdateSources() {
-    if (!pNDILib->NDIlib_find_wait_for_sources(pNDI_find, 1000 /* milliseconds */)) {
-        printf("No change to the sources found.\n");
+    // Keeping the snapshot alive keeps the menu strings valid
+    memset(source_names, 0, sizeof(source_names));
+    memset(source_ips, 0, sizeof(source_ips));
+    
+    // The last entry always stays null to terminate the list
+    const size_t max_sources = sizeof(source_names) / sizeof(source_names[0]) - 1;
+    for (size_t i = 0; i < menu_sources->size() && i < max_sources; i++) {
+        source_ips[i] = (*menu_sources)[i].url.c_str();
+        source_names[i] = (*menu_sources)[i].name.c_str();
+    }
+}
+
+void NDI_CameraControl_CHOP::ConnectByURL(const char* camera_url) {
+    if (!ndi_runtime->IsInitialized()) {
+        printf("NDI is not available\n");
+        return;
+    }
+    
+    if (!camera_url || !*camera_url) {
+        connection.Disconnect();
+        return;
+    }
+    connection.Connect(camera_url, "Custom source", receive_video);
+}
+
+void NDI_CameraControl_CHOP::ConnectByID(int id) {
+    if (!ndi_runtime->IsInitialized()) {
+        printf("NDI is not available\n");
+        return;
     }
     
-    // Get the updated list of sources
-    uint32_t no_sources = 0;
-    p_sources = pNDILib->NDIlib_find_get_current_sources(pNDI_find, &no_sources);
+    std::shared_ptr<const NDISourceList> sources = ndi_runtime->GetDiscovery().GetSources();
+    if (id < 0 || id >= (int)sources->size()) {
+        printf("No NDI source with index %d\n", id);
+        return;
+    }
     
-    // Display all the sources.
-    printf("Network sources (%u found).\n", no_sources);
-    for (uint32_t i = 0; i < no_sources; i++) {
+    connection.Connect((*sources)[id].url, (*sources)[id].name, receive_video);
+}
+
+void NDI_CameraControl_CHOP::ExecuteBank(TD::CHOP_Output* output, const TD::OP_Inputs* inputs, const TD::OP_DATInput* sources_dat, bool receive_video_new) {
+    const int bank_size = sources_dat->numRows;
+    ResizeBank(bank_size);
+    
+    const double command_rate = inputs->getParDouble("Commandrate");
+    const double command_burst = inputs->getParDouble("Commandburst");
+    const bool adaptive_rate = inputs->getParInt("Adaptiverate") != 0;
+    const bool batch_commands = inputs->getParInt("Batchcommands") != 0;
+    const double control_rate = inputs->getParDouble("Controlrate");
+    std::shared_ptr<const NDISourceList> sources;
+    
+    for (int i = 0; i < bank_size; i++) {
+        BankCamera& camera = *bank_cameras[i];
+        camera.sender.SetCommandRate(command_rate, command_burst, adaptive_rate);
+        camera.sender.SetBatching(batch_commands);
+        camera.sender.SetKeepalive(keepalive);
+        camera.sender.SetTrajectory(smoothing);
+        camera.sender.SetControlRate(control_rate);
+        camera.controller.SetControlRate(control_rate);
         
-        source_ips[i] = p_sources[i].p_url_address;
-        source_names[i] = p_sources[i].p_ndi_name;
+        const char* cell = sources_dat->getCell(i, 0);
+        const uint64_t source_hash = HashSourceURL(cell);
+        if (source_hash == camera.source_hash && receive_video_new == camera.receive_video) {
+            continue;
+        }
+        camera.source_hash = source_hash;
+        camera.receive_video = receive_video_new;
         
-        printf("%u. %s\t\t", i + 1, p_sources[i].p_ndi_name);
-        printf("%s\n", p_sources[i].p_url_address);
+        if (!cell || !*cell || !ndi_runtime->IsInitialized()) {
+            camera.connection.Disconnect();
+            continue;
+        }
         
+        // Rows can name a source the way the menu shows it, or give its URL
+        if (!sources) {
+            sources = ndi_runtime->GetDiscovery().GetSources();
+        }
+        std::string url = cell;
+        std::string name = "Bank camera";
+        for (const NDISourceInfo& source : *sources) {
+            if (source.name == cell) {
+                url = source.url;
+                name = source.name;
+                break;
+            }
+        }
+        camera.connection.Connect(url, name, receive_video_new);
+    }
+    
+    // Axes without an input channel keep their current value and aren't sent
+    bank_targets = bank_data;
+    
+    const TD::OP_CHOPInput* values = inputs->getParCHOP("Bankvalues");
+    if (values && values->numSamples > 0) {
+        for (int c = 0; c < values->numChannels; c++) {
+            const char* channel = values->getChannelName(c);
+            if (strncmp(channel, "cam", 3) != 0) {
+                continue;
+            }
+            
+            char* field_name;
+            const long cam = strtol(channel + 3, &field_name, 10);
+            if (field_name == channel + 3 || *field_name != '/' || cam < 1 || cam > bank_size) {
+                continue;
+            }
+            field_name++;
+            
+            for (int f = 0; f < NumCameraAxes; f++) {
+                if (strcmp(field_name, CameraAxes[f].channel_name) == 0) {
+                    bank_targets[cam - 1].*CameraAxes[f].field = values->getChannelData(c)[values->numSamples - 1];
+                    break;
+                }
+            }
+        }
+    }
+    
+    for (int i = 0; i < bank_size; i++) {
+        SubmitChanges(bank_data[i], bank_targets[i], bank_cameras[i]->sender, GetHeldCommands());
+        bank_cameras[i]->sender.Feed(SpeedCommands);
+        if (closed_loop) {
+            bank_cameras[i]->controller.SetTarget(bank_data[i].abs_pan, bank_data[i].abs_tilt, bank_data[i].abs_zoom, pid_gains);
+            bank_cameras[i]->controller.Start();
+        }
+        
+        float** channels = output->channels + i * NumOutputChannels;
+        for (int f = 0; f < NumCameraAxes; f++) {
+            channels[f][0] = (float)(bank_data[i].*CameraAxes[f].field);
+        }
+        WriteStatusChannels(channels + NumCameraAxes, bank_cameras[i]->connection);
     }
 }
 
-void NDI_CameraControl_CHOP::ConnectByURL(const char* camera_url) {
-    NDIlib_source_t ndi_source = { "Custom source", camera_url };
+void NDI_CameraControl_CHOP::ConsumeInput(const TD::OP_CHOPInput* input, const CameraData& target, double command_rate) {
+    int channel_of[NumCameraAxes];
+    bool any_channel = false;
+    for (int f = 0; f < NumCameraAxes; f++) {
+        channel_of[f] = -1;
+        for (int c = 0; c < input->numChannels; c++) {
+            if (strcmp(input->getChannelName(c), CameraAxes[f].channel_name) == 0) {
+                channel_of[f] = c;
+                any_channel = true;
+                break;
+            }
+        }
+    }
     
-    NDI_recv_create_desc.source_to_connect_to = ndi_source;
-    NDI_recv_create_desc.p_ndi_recv_name = "TD->NDI Camera Controller";
-    pNDI_recv = pNDILib->NDIlib_recv_create_v3(&NDI_recv_create_desc);
-    if (!pNDI_recv) {
-        printf("Error connecting to NDI source\n");
+    // Axes the input doesn't drive still follow their parameters. They go
+    // out before this slice, so they aren't held behind it.
+    CameraData sample = target;
+    for (int f = 0; f < NumCameraAxes; f++) {
+        if (channel_of[f] >= 0) {
+            sample.*CameraAxes[f].field = cam_data.*CameraAxes[f].field;
+        }
+        else {
+            input_tail.*CameraAxes[f].field = NAN;
+        }
+    }
+    SubmitChanges(cam_data, sample, ptz_sender, GetHeldCommands(), GetParameterDue());
+    
+    if (any_channel && input->numSamples > 0 && input->sampleRate > 0.0) {
+        const int last = input->numSamples - 1;
+        
+        // Anything longer than a second isn't a timeslice, only its end is current
+        if (input->numSamples > input->sampleRate) {
+            input_phase = std::max(input_phase, (double)last);
+        }
+        
+        // One tick per command interval of input, or one per sample when unlimited,
+        // so fast motion is neither skipped nor sent faster than the camera takes it
+        const double step = command_rate > 0.0 ? std::max(input->sampleRate / command_rate, 1.0) : 1.0;
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        
+        // The slice covers the time since the last cook. Playing it back one
+        // slice late keeps the spacing between the samples, and so the motion.
+        for (; input_phase <= last; input_phase += step) {
+            for (int f = 0; f < NumCameraAxes; f++) {
+                if (channel_of[f] >= 0) {
+                    sample.*CameraAxes[f].field = SampleInput(input->getChannelData(channel_of[f]), last,
+                        input_tail.*CameraAxes[f].field, input_phase);
+                }
+            }
+            
+            // Cooks don't come exactly a slice apart, a late one mustn't
+            // schedule ticks before those already queued
+            const std::chrono::steady_clock::time_point due = std::max(input_due, now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>((input_phase + 1.0) / input->sampleRate)));
+            SubmitChanges(cam_data, sample, ptz_sender, GetHeldCommands(), due);
+            input_due = due;
+        }
+        // Less than a sample before the next slice: the next tick falls
+        // between this slice's last sample and the next one's first
+        input_phase -= input->numSamples;
+        for (int f = 0; f < NumCameraAxes; f++) {
+            if (channel_of[f] >= 0) {
+                input_tail.*CameraAxes[f].field = input->getChannelData(channel_of[f])[last];
+            }
+        }
     }
 }
 
-void NDI_CameraControl_CHOP::ConnectByID(int id) {
+std::chrono::steady_clock::time_point NDI_CameraControl_CHOP::GetParameterDue() const {
+    // Due with the last input tick, which is about now, while that is still
+    // ahead: due times don't go backwards. Then right away, so a stop can
+    // skip ahead again.
+    return input_due > std::chrono::steady_clock::now() ? input_due : std::chrono::steady_clock::time_point();
+}
+
+void NDI_CameraControl_CHOP::ResetInput() {
+    input_phase = 0.0;
+    for (const AxisDescriptor& axis : CameraAxes) {
+        input_tail.*axis.field = NAN;
+    }
+}
+
+void NDI_CameraControl_CHOP::ResizeBank(int size) {
+    // Dropping a camera stops its threads and releases its receiver
+    while ((int)bank_cameras.size() > size) {
+        bank_cameras.pop_back();
+    }
+    while ((int)bank_cameras.size() < size) {
+        std::unique_ptr<BankCamera> camera(new BankCamera());
+        camera->sender.Start(pNDILib);
+        camera->connection.Start(ndi_runtime->GetReceivers(), pNDILib);
+        bank_cameras.push_back(std::move(camera));
+    }
     
-    UpdateSources();
+    // New cameras start from zero, like the single camera does
+    bank_data.resize(size);
+    bank_targets.resize(size);
+}
+
+void NDI_CameraControl_CHOP::UpdateEnabledPars(const TD::OP_Inputs* inputs) {
+    // The camera picked on the parameters page and its axes sit out while a bank is driven,
+    // the gains only matter in closed loop, the limits with smooth moves and the control rate with either.
+    // Velocity mode has no use for the absolute values, only it for the keepalive.
+    const uint32_t all_pars = (1u << NumEnablePars) - 1;
+    const uint32_t source_pars = ((1u << NumCameraAxes) - 1) | EnableBit(EnablePar::AvailableSources);
+    uint32_t enabled = bank_mode ? 0 : source_pars;
+    if (velocity_mode) {
+        for (int f = 0; f < NumCameraAxes; f++) {
+            if (AbsoluteCommands & (1u << (int)CameraAxes[f].command)) {
+                enabled &= ~(1u << f);
+            }
+        }
+        enabled |= EnableBit(EnablePar::KeepaliveRate) | EnableBit(EnablePar::DeadmanTimeout);
+    }
+    if (closed_loop) {
+        enabled |= EnableBit(EnablePar::PidGains);
+    }
+    if (smoothing.enabled) {
+        enabled |= EnableBit(EnablePar::MaxVelocity) | EnableBit(EnablePar::MaxAccel) | EnableBit(EnablePar::MaxJerk);
+    }
+    if (closed_loop || smoothing.enabled) {
+        enabled |= EnableBit(EnablePar::ControlRate);
+    }
     
-    NDI_recv_create_desc.source_to_connect_to = p_sources[id];
-    NDI_recv_create_desc.p_ndi_recv_name = "TD->NDI Camera Controller made by Kostiantyn Yerokhin";
-    pNDI_recv = pNDILib->NDIlib_recv_create_v3(&NDI_recv_create_desc);
-    if (!pNDI_recv) {
-        printf("Error connecting to NDI source\n");
+    const uint32_t changed = enabled_pars_pushed ? enabled ^ enabled_pars : all_pars;
+    for (int i = 0; i < NumEnablePars; i++) {
+        if (changed & (1u << i)) {
+            inputs->enablePar(GetEnableParName(i), (enabled >> i) & 1);
+        }
+    }
+    enabled_pars = enabled;
+    enabled_pars_pushed = true;
+}
+
+void NDI_CameraControl_CHOP::StopClosedLoop() {
+    // Open loop takes over from wherever the heads stopped, so the
+    // parameters are sent again rather than assumed to be there
+    position_controller.Stop();
+    ForgetSent(cam_data, ClosedLoopCommands);
+    for (size_t i = 0; i < bank_cameras.size(); i++) {
+        bank_cameras[i]->controller.Stop();
+        ForgetSent(bank_data[i], ClosedLoopCommands);
+    }
+}
+
+void NDI_CameraControl_CHOP::StopAll() {
+    // Control loops first, they would steer straight back. The heads stay
+    // wherever they stopped, the parameters aren't sent again.
+    if (closed_loop) {
+        position_controller.Stop();
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            camera->controller.Stop();
+        }
+        closed_loop = false;
+        closed_loop_halted = true;
+    }
+    
+    ptz_sender.EmergencyStop();
+    for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+        camera->sender.EmergencyStop();
+    }
+}
+
+void NDI_CameraControl_CHOP::UpdateSendRates() {
+    // Counted over a second or more, so a single cook's burst doesn't show as a rate
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - send_rates_sampled_at).count();
+    if (elapsed < 1.0) {
+        return;
+    }
+    
+    for (int i = 0; i < NumPTZCommandTypes; i++) {
+        uint64_t sent = ptz_sender.GetSentCount((PTZCommandType)i);
+        for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+            sent += camera->sender.GetSentCount((PTZCommandType)i);
+        }
+        // Cameras leaving the bank take their counts with them
+        send_rates[i] = sent >= sent_sampled[i] ? (double)(sent - sent_sampled[i]) / elapsed : 0.0;
+        sent_sampled[i] = sent;
+    }
+    send_rates_sampled_at = now;
+}
+
+uint64_t NDI_CameraControl_CHOP::SumSenders(uint64_t (CommandSender::*counter)() const) const {
+    uint64_t sum = (ptz_sender.*counter)();
+    for (const std::unique_ptr<BankCamera>& camera : bank_cameras) {
+        sum += (camera->sender.*counter)();
     }
+    return sum;
 }
@@ -22,11 +22,17 @@
 
 #include <Processing.NDI.Lib.h>
 #include "/Library/NDI SDK for Apple/examples/C++/NDIlib_Send_VirtualPTZ/rapidxml/rapidxml.hpp"
+#include "NDI_CameraAxes.h"
+#include "NDI_CommandSender.h"
+#include "NDI_Connection.h"
+#include "NDI_PositionController.h"
+#include "NDI_Runtime.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <cmath>
 #include <assert.h>
+#include <algorithm>
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <string>
@@ -47,20 +53,42 @@ of the input will get used.
 If no input is connected then the node will output a smooth sine wave at 120hz.
 */
 
-struct CameraData {
-    double abs_pan;
-    double abs_tilt;
-    double abs_zoom;
-    double abs_focus;
+// One camera of a bank. Threads and locks can't be moved, so these live
+// behind pointers while the values they're fed stay contiguous.
+struct BankCamera {
+    BankCamera() : connection(sender), controller(sender, connection) {}
 
-    double speed_pan;
-    double speed_tilt;
-    double speed_zoom;
-    double speed_focus;
+    CommandSender sender;
+    CameraConnection connection;
+    PositionController controller;
 
-    double gain;
-    double iris;
-    double shutter_speed;
+    // What the connection was last asked for
+    uint64_t source_hash = 0;
+    bool receive_video = false;
+};
+
+// Parameters other than the axes whose enable state follows the mode.
+// Their enable state bits come after the axes', see EnableBit().
+enum class EnablePar : int {
+    AvailableSources,
+    PidGains,
+    MaxVelocity,
+    MaxAccel,
+    MaxJerk,
+    ControlRate,
+    KeepaliveRate,
+    DeadmanTimeout,
+};
+
+const int NumOtherEnablePars = (int)EnablePar::DeadmanTimeout + 1;
+
+// How long cooks take, in nanoseconds
+struct CookTime {
+    int64_t last_ns = 0;
+    double average_ns = 0.0;
+    int64_t max_ns = 0;
+
+    void Record(int64_t ns);
 };
 
 // To get more help about these functions, look at CHOP_CPlusPlusBase.h
@@ -100,6 +128,35 @@ public:
     // NDI Finder
 private:
 
+    // Bank mode: one instance drives every camera listed in the Bank Sources DAT
+    void ExecuteBank(TD::CHOP_Output* output, const TD::OP_Inputs* inputs, const TD::OP_DATInput* sources_dat, bool receive_video_new);
+    void ResizeBank(int size);
+
+    // Pushes parameter enable state to TD, only for the parameters whose state changed
+    void UpdateEnabledPars(const TD::OP_Inputs* inputs);
+
+    // Hands pan, tilt and zoom back from the control loops to the parameters
+    void StopClosedLoop();
+
+    // Stop All: halts every camera, past everything queued and the rate limit
+    void StopAll();
+
+    // Commands the parameters don't send while the control loops drive the heads,
+    // or, in velocity mode, the speeds
+    uint32_t GetHeldCommands() const { return (closed_loop ? ClosedLoopCommands : 0) | (velocity_mode ? AbsoluteCommands : 0); }
+
+    // Input CHOP mode: plays back every channel named like an output,
+    // resampled to the command rate, over the timeslice it arrived in
+    void ConsumeInput(const TD::OP_CHOPInput* input, const CameraData& target, double command_rate);
+    void ResetInput();
+    std::chrono::steady_clock::time_point GetParameterDue() const;
+
+    // Totals over the single camera and the whole bank
+    uint64_t SumSenders(uint64_t (CommandSender::*counter)() const) const;
+
+    // Recomputes send_rates once at least a second has passed
+    void UpdateSendRates();
+
     // We don't need to store this pointer, but we do for the example.
     // The OP_NodeInfo class store information about the node that's using
     // this instance of the class (like its name).
@@ -109,17 +166,82 @@ private:
     // function is called, then passes back to the CHOP
     int32_t                myExecuteCount;
 
-    double                myOffset;
+    // Control path health for the Info CHOP. The senders' counters are
+    // atomics their threads bump, these are only read on the cook thread.
+    CookTime cook_time;
+    std::chrono::steady_clock::time_point send_rates_sampled_at;
+    uint64_t sent_sampled[NumPTZCommandTypes] = {};
+    double send_rates[NumPTZCommandTypes] = {};
 
     // NDI specific stuff
+    const NDIlib_v3* pNDILib = nullptr;
     
-    // list of all NDI source names & ips
+    // NDI itself and the source finder are shared by all instances
+    NDIRuntime* ndi_runtime;
+
+    // list of all NDI source names & ips, pointing into menu_sources
     // array size is arbitrary
+    std::shared_ptr<const NDISourceList> menu_sources;
     const char* source_names[256];
     const char* source_ips[256];
 
-    char* selected_id_old = 0;
+    // Selected source, tracked by content: TD may hand back a different
+    // buffer for the same string, which must not cost us a reconnect
+    uint64_t selected_hash = 0;
+    // Bumped on every real change of source or receive mode
+    uint32_t selection_generation = 0;
 
     CameraData cam_data = {};
 
+    // Position of the next command tick in the input's samples,
+    // relative to the start of the next timeslice
+    double input_phase = 0.0;
+    // Each input channel's last sample of the previous slice, NAN if it had none
+    CameraData input_tail = {};
+    // Due time of the last input tick queued. Due times never go backwards.
+    std::chrono::steady_clock::time_point input_due;
+
+    // Control-only connections ask NDI for metadata only,
+    // video is negotiated only when explicitly requested
+    bool receive_video = false;
+
+    // Enable state last pushed to TD, bit i is CameraAxes[i], then EnablePar.
+    // enablePar is a host call, so it's made only when the state changes.
+    static const int NumEnablePars = NumCameraAxes + NumOtherEnablePars;
+    uint32_t enabled_pars = 0;
+    bool enabled_pars_pushed = false;
+
+    // PTZ calls are queued here and made on the sender's own thread,
+    // so a slow camera never stalls the cook
+    CommandSender ptz_sender;
+
+    // Owns our reference on the camera and keeps it alive in the background.
+    // Declared after ptz_sender, which it hands receivers to.
+    CameraConnection connection;
+
+    // Velocity mode: the speeds drive the heads, kept alive by the senders
+    bool velocity_mode = false;
+    KeepaliveSettings keepalive = {};
+
+    // Closed loop mode: pan, tilt and zoom are steered from the camera's
+    // reported position by a control loop per camera
+    PositionController position_controller;
+    bool closed_loop = false;
+    bool closed_loop_halted = false;    // by Stop All, until Closed Loop is switched off
+    PIDGains pid_gains = {};
+
+    // Preset the Recall Preset pulse sends, and how fast the head gets there
+    int preset = 0;
+    double preset_speed = 1.0;
+
+    // Absolute moves as jerk-limited S-curves, planned on the sender threads
+    TrajectorySettings smoothing = {};
+
+    // Bank mode state, index i is camera cam<i+1>. Values are kept apart
+    // from the cameras so one cook diffs the whole bank in a single pass.
+    bool bank_mode = false;
+    std::vector<CameraData> bank_data;
+    std::vector<CameraData> bank_targets;
+    std::vector<std::unique_ptr<BankCamera>> bank_cameras;
+
 };
@@ -0,0 +1,262 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Reads back where the camera actually is. A capture thread per receiver
+ *    picks the camera's PTZ reports out of its metadata stream.
+ */
+
+#include "NDI_CameraFeedback.h"
+
+#include <math.h>
+#include <string.h>
+
+// A command the camera hasn't acted on by then isn't timed
+static const std::chrono::seconds command_timeout(2);
+
+// Digits past this only move the exponent or are dropped, a double holds no more anyway
+static const uint64_t max_mantissa = 100000000000000000ull;
+
+static bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Reads a number the way the camera writes it, always with a point. Not
+// strtod, which follows LC_NUMERIC and would stop at the point where the
+// decimal separator is a comma. 0 if there's no number.
+static double ParseNumber(const char* text) {
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    const bool negative = *text == '-';
+    if (*text == '-' || *text == '+') {
+        text++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; IsDigit(*text); text++, any = true) {
+        if (mantissa < max_mantissa) {
+            mantissa = mantissa * 10 + (uint64_t)(*text - '0');
+        }
+        else {
+            exponent++;
+        }
+    }
+    if (*text == '.') {
+        for (text++; IsDigit(*text); text++, any = true) {
+            if (mantissa < max_mantissa) {
+                mantissa = mantissa * 10 + (uint64_t)(*text - '0');
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return 0.0;
+    }
+
+    if (*text == 'e' || *text == 'E') {
+        const char* power = text + 1;
+        const bool negative_power = *power == '-';
+        if (*power == '-' || *power == '+') {
+            power++;
+        }
+        int written = 0;
+        for (; IsDigit(*power); power++) {
+            if (written < 1000) {
+                written = written * 10 + (*power - '0');
+            }
+        }
+        exponent += negative_power ? -written : written;
+    }
+
+    // Dividing by an exact power of ten rounds better than multiplying by an inexact one
+    double value = (double)mantissa;
+    if (exponent < 0) {
+        value /= pow(10.0, -exponent);
+    }
+    else if (exponent > 0) {
+        value *= pow(10.0, exponent);
+    }
+    return negative ? -value : value;
+}
+
+CameraFeedback::CameraFeedback() : pNDILib(nullptr), pNDI_recv(nullptr), running(false), in_flight_count(0), answers_head(0), answers_count(0), latest()
+{
+}
+
+CameraFeedback::~CameraFeedback()
+{
+    Stop();
+}
+
+void CameraFeedback::Start(const NDIlib_v3* lib, NDIlib_recv_instance_t recv) {
+    if (running.exchange(true)) {
+        return;
+    }
+    pNDILib = lib;
+    pNDI_recv = recv;
+    worker = std::thread(&CameraFeedback::Run, this);
+}
+
+void CameraFeedback::Stop() {
+    running.store(false);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void CameraFeedback::Run() {
+    while (running.load()) {
+        // Video and audio aren't asked for, so the SDK drops them for us.
+        // The timeout bounds how long Stop() waits.
+        NDIlib_metadata_frame_t metadata;
+        if (pNDILib->NDIlib_recv_capture_v2(pNDI_recv, nullptr, nullptr, &metadata, 100) == NDIlib_frame_type_metadata) {
+            Parse(metadata.p_data);
+            pNDILib->NDIlib_recv_free_metadata(pNDI_recv, &metadata);
+        }
+    }
+}
+
+void CameraFeedback::Parse(char* xml) {
+    if (!xml) {
+        return;
+    }
+
+    // In situ: the frame is ours until it's freed, so names and values are
+    // terminated in place and point straight into it, nothing is copied
+    try {
+        document.parse<rapidxml::parse_no_data_nodes>(xml);
+    }
+    catch (const rapidxml::parse_error&) {
+        document.clear();
+        return;
+    }
+
+    // Reports come on their own or wrapped in one element
+    const CameraPosition previous = latest;
+    bool reported = false;
+    for (const rapidxml::xml_node<>* node = document.first_node(); node; node = node->next_sibling()) {
+        reported |= ParseNode(node);
+        for (const rapidxml::xml_node<>* child = node->first_node(); child; child = child->next_sibling()) {
+            reported |= ParseNode(child);
+        }
+    }
+    document.clear();
+
+    if (reported) {
+        latest.reports++;
+        latest.reported_at = std::chrono::steady_clock::now();
+        position.Store(latest);
+        TimeCommands(previous, latest.reported_at);
+    }
+}
+
+void CameraFeedback::CommandSent(std::chrono::steady_clock::time_point sent_at, uint32_t axes) {
+    if (axes == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(timing_mutex);
+    Expire(sent_at);
+    // Commands come faster than the camera answers: the oldest is given up on
+    if (in_flight_count == MaxInFlight) {
+        Answer(0, sent_at, false);
+    }
+    in_flight[in_flight_count].sent_at = sent_at;
+    in_flight[in_flight_count].axes = axes;
+    in_flight_count++;
+}
+
+int CameraFeedback::TakeAnswers(CommandAnswer* out, int max) {
+    std::lock_guard<std::mutex> lock(timing_mutex);
+    // A camera that never reports has its commands given up on all the same
+    Expire(std::chrono::steady_clock::now());
+
+    int count = 0;
+    while (count < max && answers_count > 0) {
+        out[count++] = answers[answers_head];
+        answers_head = (answers_head + 1) % MaxAnswers;
+        answers_count--;
+    }
+    return count;
+}
+
+void CameraFeedback::TimeCommands(const CameraPosition& previous, std::chrono::steady_clock::time_point now) {
+    uint32_t moved =
+        (latest.pan != previous.pan ? (uint32_t)PositionPan : 0u) |
+        (latest.tilt != previous.tilt ? (uint32_t)PositionTilt : 0u) |
+        (latest.zoom != previous.zoom ? (uint32_t)PositionZoom : 0u) |
+        (latest.focus != previous.focus ? (uint32_t)PositionFocus : 0u);
+
+    std::lock_guard<std::mutex> lock(timing_mutex);
+    Expire(now);
+
+    // Cameras act on commands in order, so each moved axis answers the
+    // oldest command for it. One that moves several axes is answered by
+    // the first of them to move.
+    for (int i = 0; i < in_flight_count && moved != 0;) {
+        const uint32_t axes = in_flight[i].axes;
+        if ((axes & moved) && in_flight[i].sent_at <= now) {
+            moved &= ~axes;
+            Answer(i, now, true);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void CameraFeedback::Expire(std::chrono::steady_clock::time_point now) {
+    // Moved to where it already was, or the camera doesn't report this axis
+    while (in_flight_count > 0 && now - in_flight[0].sent_at > command_timeout) {
+        Answer(0, now, false);
+    }
+}
+
+void CameraFeedback::Answer(int index, std::chrono::steady_clock::time_point now, bool answered) {
+    CommandAnswer& answer = answers[(answers_head + answers_count) % MaxAnswers];
+    if (answers_count < MaxAnswers) {
+        answers_count++;
+    }
+    else {
+        answers_head = (answers_head + 1) % MaxAnswers;
+    }
+    answer.sent_at = in_flight[index].sent_at;
+    answer.latency = answered ? now - answer.sent_at : std::chrono::steady_clock::duration::zero();
+    answer.answered = answered;
+    if (answered) {
+        latency.Record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(answer.latency).count());
+    }
+
+    in_flight_count--;
+    for (int i = index; i < in_flight_count; i++) {
+        in_flight[i] = in_flight[i + 1];
+    }
+}
+
+// Same elements the PTZ commands use, carrying absolute values
+bool CameraFeedback::ParseNode(const rapidxml::xml_node<>* node) {
+    struct Report {
+        const char* element;
+        const char* attribute;
+        double CameraPosition::* field;
+    };
+    static const Report reports[] = {
+        { "ntk_ptz_pan_tilt", "pan", &CameraPosition::pan },
+        { "ntk_ptz_pan_tilt", "tilt", &CameraPosition::tilt },
+        { "ntk_ptz_zoom", "zoom", &CameraPosition::zoom },
+        { "ntk_ptz_focus", "focus", &CameraPosition::focus },
+    };
+
+    bool parsed = false;
+    for (const Report& report : reports) {
+        if (strcmp(node->name(), report.element) != 0) {
+            continue;
+        }
+        const rapidxml::xml_attribute<>* attribute = node->first_attribute(report.attribute);
+        if (attribute) {
+            latest.*report.field = ParseNumber(attribute->value());
+            parsed = true;
+        }
+    }
+    return parsed;
+}
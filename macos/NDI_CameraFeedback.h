@@ -0,0 +1,114 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Reads back where the camera actually is. A capture thread per receiver
+ *    picks the camera's PTZ reports out of its metadata stream.
+ */
+
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+#include "/Library/NDI SDK for Apple/examples/C++/NDIlib_Send_VirtualPTZ/rapidxml/rapidxml.hpp"
+#include "NDI_LatencyHistogram.h"
+#include "NDI_SeqLock.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Last position the camera reported. Axes it never reported stay at 0.
+struct CameraPosition {
+    double pan;
+    double tilt;
+    double zoom;
+    double focus;
+
+    // Metadata frames that carried any of the above, and when the last one came in
+    uint64_t reports;
+    std::chrono::steady_clock::time_point reported_at;
+};
+
+// Axes of a CameraPosition, as bits
+enum PositionAxis : uint32_t {
+    PositionPan = 1u << 0,
+    PositionTilt = 1u << 1,
+    PositionZoom = 1u << 2,
+    PositionFocus = 1u << 3,
+};
+
+// How a timed command turned out
+struct CommandAnswer {
+    std::chrono::steady_clock::time_point sent_at;
+    // Until the camera reported one of its axes moving, zero if it never did
+    std::chrono::steady_clock::duration latency;
+    bool answered;
+};
+
+class CameraFeedback
+{
+public:
+    CameraFeedback();
+    ~CameraFeedback();
+
+    void Start(const NDIlib_v3* lib, NDIlib_recv_instance_t recv);
+    void Stop();
+
+    // Any thread
+    CameraPosition GetPosition() const { return position.Load(); }
+
+    // Any thread. A command moving these axes went out at sent_at. It is timed
+    // until the first report that has one of them moved. Every command in
+    // flight is timed: a report answers the oldest one for each axis it moved.
+    void CommandSent(std::chrono::steady_clock::time_point sent_at, uint32_t axes);
+
+    // Any thread. Writes up to max of the commands answered or given up on
+    // since the last call, oldest first, and returns how many. Only the
+    // latest MaxAnswers are kept for the taking.
+    int TakeAnswers(CommandAnswer* out, int max);
+
+    // Command to feedback latency, timed as above
+    LatencySummary GetLatencySummary() const { return latency.Summarize(); }
+    void ResetLatency() { latency.Reset(); }
+
+    static const int MaxInFlight = 32;
+    static const int MaxAnswers = 32;
+
+private:
+    void Run();
+    void Parse(char* xml);
+    bool ParseNode(const rapidxml::xml_node<>* node);
+    void TimeCommands(const CameraPosition& previous, std::chrono::steady_clock::time_point now);
+    // Timing lock must be held
+    void Expire(std::chrono::steady_clock::time_point now);
+    void Answer(int index, std::chrono::steady_clock::time_point now, bool answered);
+
+    const NDIlib_v3* pNDILib;
+    NDIlib_recv_instance_t pNDI_recv;
+
+    std::atomic<bool> running;
+    std::thread worker;
+
+    SeqLock<CameraPosition> position;
+
+    LatencyHistogram latency;
+
+    struct TimedCommand {
+        std::chrono::steady_clock::time_point sent_at;
+        uint32_t axes;
+    };
+
+    // Commands not answered yet, oldest first, and the answers not taken yet,
+    // a ring that overwrites its oldest
+    std::mutex timing_mutex;
+    TimedCommand in_flight[MaxInFlight];
+    int in_flight_count;
+    CommandAnswer answers[MaxAnswers];
+    int answers_head;
+    int answers_count;
+
+    // Capture thread only. The document is reused so its node pool
+    // is allocated once, not per frame.
+    CameraPosition latest;
+    rapidxml::xml_document<> document;
+};
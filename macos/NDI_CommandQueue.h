@@ -0,0 +1,319 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    PTZ command records, the lock-free queue that carries them
+ *    from the cook thread to the sender thread and the per-axis mailbox
+ *    the sender drains them into.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+
+// One PTZ call to be made on the receiver. Values are stored as floats
+// because that is what the NDIlib_recv_ptz_* functions take.
+enum class PTZCommandType : uint8_t {
+    PanTilt,
+    PanTiltSpeed,
+    Zoom,
+    ZoomSpeed,
+    Focus,
+    FocusSpeed,
+    ExposureManual,
+    RecallPreset,
+};
+
+// Every command type drives its own axis, so this is also the number of axes
+const int NumPTZCommandTypes = (int)PTZCommandType::RecallPreset + 1;
+
+// Commands that move the head: a preset recall makes the pending ones stale
+const uint32_t AbsoluteCommands = (1u << (int)PTZCommandType::PanTilt) | (1u << (int)PTZCommandType::Zoom) |
+    (1u << (int)PTZCommandType::Focus);
+const uint32_t SpeedCommands = (1u << (int)PTZCommandType::PanTiltSpeed) | (1u << (int)PTZCommandType::ZoomSpeed) |
+    (1u << (int)PTZCommandType::FocusSpeed);
+const uint32_t MotionCommands = AbsoluteCommands | SpeedCommands;
+
+struct PTZCommand {
+    PTZCommandType type;
+    float a; // pan, zoom, focus, iris or preset
+    float b; // tilt, gain or preset speed
+    float c; // shutter speed
+
+    // Not sent before this. Left at the clock's epoch it goes out right away.
+    std::chrono::steady_clock::time_point due;
+
+    // Order the commands were submitted in, across every lane into the
+    // sender. A command never overrides a newer one for its axis. 0 if unstamped.
+    uint64_t sequence;
+
+    // Going out again rather than new, replayed or kept alive. The camera
+    // may be there already, so the send isn't timed.
+    bool resend;
+};
+
+// Fields left out, the due time among them, are zero. Use this rather than
+// brace lists, which silently lose track of fields added later.
+inline PTZCommand MakeCommand(PTZCommandType type, float a = 0.f, float b = 0.f, float c = 0.f) {
+    PTZCommand command = {};
+    command.type = type;
+    command.a = a;
+    command.b = b;
+    command.c = c;
+    return command;
+}
+
+// Order the mailbox sends pending commands in. Lower goes first.
+enum class PTZPriority : uint8_t {
+    Stop,
+    Preset,
+    Position,
+    Exposure,
+};
+
+// A speed command of zero is a stop, whatever sent it
+inline PTZPriority GetPriority(const PTZCommand& command) {
+    switch (command.type) {
+    case PTZCommandType::PanTiltSpeed:
+        return command.a == 0.f && command.b == 0.f ? PTZPriority::Stop : PTZPriority::Position;
+    case PTZCommandType::ZoomSpeed:
+    case PTZCommandType::FocusSpeed:
+        return command.a == 0.f ? PTZPriority::Stop : PTZPriority::Position;
+    case PTZCommandType::RecallPreset:
+        return PTZPriority::Preset;
+    case PTZCommandType::ExposureManual:
+        return PTZPriority::Exposure;
+    default:
+        return PTZPriority::Position;
+    }
+}
+
+// Pending commands a new one makes stale on top of its own axis: a stop
+// drops the absolute move of the same axis, a preset recall every move
+inline uint32_t GetPreempted(const PTZCommand& command) {
+    switch (GetPriority(command)) {
+    case PTZPriority::Stop:
+        switch (command.type) {
+        case PTZCommandType::PanTiltSpeed: return 1u << (int)PTZCommandType::PanTilt;
+        case PTZCommandType::ZoomSpeed: return 1u << (int)PTZCommandType::Zoom;
+        case PTZCommandType::FocusSpeed: return 1u << (int)PTZCommandType::Focus;
+        default: return 0;
+        }
+    case PTZPriority::Preset:
+        return MotionCommands;
+    default:
+        return 0;
+    }
+}
+
+// Bounded single-producer/single-consumer ring buffer.
+// TryPush() must only be called from one thread and TryPop() from one other thread.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool TryPush(const T& item) {
+        const size_t tail = tail_index.load(std::memory_order_relaxed);
+        if (tail - head_cache == Capacity) {
+            head_cache = head_index.load(std::memory_order_acquire);
+            if (tail - head_cache == Capacity) {
+                return false;
+            }
+        }
+        slots[tail & (Capacity - 1)] = item;
+        tail_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        const size_t head = head_index.load(std::memory_order_relaxed);
+        if (head == tail_cache) {
+            tail_cache = tail_index.load(std::memory_order_acquire);
+            if (head == tail_cache) {
+                return false;
+            }
+        }
+        item = slots[head & (Capacity - 1)];
+        head_index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Copies the oldest item without removing it.
+    bool TryPeek(T& item) {
+        const size_t head = head_index.load(std::memory_order_relaxed);
+        if (head == tail_cache) {
+            tail_cache = tail_index.load(std::memory_order_acquire);
+            if (head == tail_cache) {
+                return false;
+            }
+        }
+        item = slots[head & (Capacity - 1)];
+        return true;
+    }
+
+    // Only a snapshot, the other side may be moving.
+    size_t SizeApprox() const {
+        return tail_index.load(std::memory_order_acquire) - head_index.load(std::memory_order_acquire);
+    }
+
+private:
+    static const size_t CacheLine = 64;
+
+    // Producer and consumer indices live on separate cache lines so the two
+    // threads don't keep stealing the line from each other. Padded rather than
+    // aligned: queues are members of objects made with plain new, which only
+    // honours over-alignment from C++17 on, and the macOS build is C++11.
+    // A line's worth of bytes between two fields keeps them apart wherever
+    // the object starts.
+    char leading_padding[CacheLine];
+
+    std::atomic<size_t> tail_index{ 0 };
+    size_t head_cache = 0;    // producer's copy of head_index
+    char producer_padding[CacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    std::atomic<size_t> head_index{ 0 };
+    size_t tail_cache = 0;    // consumer's copy of tail_index
+    char consumer_padding[CacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    T slots[Capacity];
+};
+
+// Latest-value-wins store with one slot per axis. Owned by the sender thread:
+// a newer command for an axis replaces the pending one instead of queueing
+// behind it, so the camera only ever gets the freshest value. Newer is by
+// submission order, not arrival: commands take different lanes to get here.
+// Stops go out before preset recalls, those before moves and moves before exposure.
+class CommandMailbox {
+public:
+    // Whether a command submitted after this one already took its axis,
+    // directly or by pre-empting it
+    bool IsStale(const PTZCommand& command) const {
+        return command.sequence < superseded[(int)command.type];
+    }
+
+    // Makes the commands submitted before this one stale for its axis and
+    // the axes it pre-empts. False, changing nothing, if it is stale itself.
+    bool Supersede(const PTZCommand& command) {
+        if (IsStale(command)) {
+            return false;
+        }
+        const uint32_t preempted = GetPreempted(command) | (1u << (uint32_t)command.type);
+        for (int axis = 0; axis < NumPTZCommandTypes; axis++) {
+            if ((preempted & (1u << axis)) && superseded[axis] < command.sequence) {
+                superseded[axis] = command.sequence;
+            }
+        }
+        return true;
+    }
+
+    // Returns true if a pending command for the same axis was replaced,
+    // one the new command pre-empts was dropped or the new one was stale.
+    bool Put(const PTZCommand& command) {
+        if (!Supersede(command)) {
+            return true;
+        }
+        const uint32_t bit = 1u << (uint32_t)command.type;
+        const PTZPriority priority = GetPriority(command);
+
+        // A stop or recall makes the less urgent pending moves given before
+        // it stale, and not worth replaying either. A recall leaves pending stops be.
+        uint32_t stale = GetPreempted(command);
+        for (int axis = 0; axis < NumPTZCommandTypes; axis++) {
+            if ((stale & pending & (1u << axis)) &&
+                (GetPriority(slots[axis]) <= priority || slots[axis].sequence > command.sequence)) {
+                stale &= ~(1u << axis);
+            }
+        }
+        const bool conflated = (pending & (bit | stale)) != 0;
+        pending &= ~stale;
+        seen &= ~stale;
+
+        slots[(int)command.type] = command;
+        pending |= bit;
+        // A preset recall is a one-off, not a state to bring back
+        if (command.type != PTZCommandType::RecallPreset) {
+            seen |= bit;
+        }
+        return conflated;
+    }
+
+    // Drops everything pending, and forgets it for replays. What was
+    // superseded stays so, commands from before are still stale.
+    void Clear() {
+        pending = 0;
+        seen = 0;
+    }
+
+    // Marks the last command of every axis pending again, e.g. to bring a
+    // camera that lost its state back to where it was told to be.
+    void Replay() {
+        for (int i = 0; i < NumPTZCommandTypes; i++) {
+            if (seen & ~pending & (1u << i)) {
+                slots[i].resend = true;
+            }
+        }
+        pending |= seen;
+    }
+
+    // Takes the most urgent pending axis, round robin among equals, so a
+    // constantly changing axis can't starve the others of its class.
+    // Resends go after every fresh command, whatever their priority.
+    bool Take(PTZCommand& command) {
+        int best = -1;
+        for (int i = 0; i < NumPTZCommandTypes && pending != 0; i++) {
+            const int axis = (next_axis + i) % NumPTZCommandTypes;
+            if ((pending & (1u << axis)) && (best < 0 || Precedes(slots[axis], slots[best]))) {
+                best = axis;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        command = slots[best];
+        pending &= ~(1u << best);
+        next_axis = best + 1;
+        return true;
+    }
+
+    // Takes every pending command of the axes in mask at once, returns how many
+    int TakeAll(uint32_t mask, PTZCommand* commands) {
+        int count = 0;
+        for (int axis = 0; axis < NumPTZCommandTypes; axis++) {
+            const uint32_t bit = 1u << axis;
+            if (pending & mask & bit) {
+                commands[count++] = slots[axis];
+                pending &= ~bit;
+            }
+        }
+        return count;
+    }
+
+    bool Empty() const { return pending == 0; }
+
+    bool IsPending(PTZCommandType type) const { return (pending & (1u << (int)type)) != 0; }
+
+    int GetPendingCount() const {
+        int count = 0;
+        for (uint32_t bits = pending; bits != 0; bits &= bits - 1) {
+            count++;
+        }
+        return count;
+    }
+
+private:
+    static bool Precedes(const PTZCommand& command, const PTZCommand& other) {
+        if (command.resend != other.resend) {
+            return other.resend;
+        }
+        return GetPriority(command) < GetPriority(other);
+    }
+
+    PTZCommand slots[NumPTZCommandTypes] = {};
+    uint32_t pending = 0;
+    uint32_t seen = 0;    // axes that ever had a command, slots keep the last one
+    int next_axis = 0;
+    // Per axis, commands submitted before this one are stale
+    uint64_t superseded[NumPTZCommandTypes] = {};
+};
@@ -0,0 +1,172 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Sender thread that makes the blocking NDIlib_recv_ptz_* calls
+ *    on behalf of the cook thread.
+ */
+
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+#include "NDI_CommandLanes.h"
+#include "NDI_CommandQueue.h"
+#include "NDI_PTZXml.h"
+#include "NDI_ReceiverPool.h"
+#include "NDI_SeqLock.h"
+#include "NDI_TrajectoryPlanner.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Velocity mode's dead man: speeds are sent again at rate, and an axis
+// the cook hasn't fed for timeout seconds is stopped
+struct KeepaliveSettings {
+    bool enabled;
+    double rate;
+    double timeout;
+};
+
+class CommandSender
+{
+public:
+    CommandSender();
+    ~CommandSender();
+
+    void Start(const NDIlib_v3* lib);
+    void Stop();
+
+    // Receiver the queued commands are sent to. May be changed while running.
+    // The sender keeps its own reference for as long as a call is in flight.
+    void SetReceiver(const std::shared_ptr<SharedReceiver>& recv);
+
+    // Commands per second the camera is fed at, with bursts of up to burst
+    // commands. The budget belongs to the camera and is shared with every other
+    // instance on it. Commands arriving faster than this are conflated per axis.
+    // A rate of 0 sends as fast as possible. Adaptive, the rate is a ceiling
+    // and the camera is fed as fast as its command latency says it keeps up.
+    void SetCommandRate(double rate, double burst = 1.0, bool adaptive = false);
+
+    // Cook thread only. Returns false if the queue is full and the command was dropped.
+    // A due time holds the command back until then; due times must not go backwards.
+    // Stops and preset recalls due right away skip ahead of commands held back.
+    bool Submit(const PTZCommand& command,
+        std::chrono::steady_clock::time_point due = std::chrono::steady_clock::time_point());
+
+    // Control loop thread only. Same as Submit, through a queue of its own
+    // so the loop and the cook thread each stay the single producer of theirs.
+    bool SubmitControl(const PTZCommand& command);
+
+    // Cook thread. While enabled, absolute pan, tilt, zoom and focus
+    // commands are turned into jerk-limited moves.
+    void SetTrajectory(const TrajectorySettings& settings);
+
+    // Ticks per second planned moves are advanced at
+    void SetControlRate(double rate);
+
+    // Cook thread. Feed marks the speed commands' axes as freshly given,
+    // whether their values changed or not.
+    void SetKeepalive(const KeepaliveSettings& settings);
+    void Feed(uint32_t commands);
+
+    // While enabled, the pan, tilt, zoom and focus commands pending together
+    // go out as one metadata frame instead of one frame per call
+    void SetBatching(bool enabled);
+
+    // Any thread. Sends the last command of every axis again, once.
+    void RequestReplay();
+
+    // Any thread. Drops every queued, pending and planned command and stops
+    // pan, tilt, zoom and focus at once, past the rate limit and whoever
+    // has control of the camera.
+    void EmergencyStop();
+
+    uint64_t GetSubmittedCount() const { return submitted_count.load(std::memory_order_relaxed); }
+    uint64_t GetSentCount() const { return sent_count.load(std::memory_order_relaxed); }
+    uint64_t GetConflatedCount() const { return conflated_count.load(std::memory_order_relaxed); }
+    uint64_t GetDroppedCount() const { return dropped_count.load(std::memory_order_relaxed); }
+    uint64_t GetBlockedCount() const { return blocked_count.load(std::memory_order_relaxed); }
+    uint64_t GetThrottledCount() const { return throttled_count.load(std::memory_order_relaxed); }
+    uint64_t GetFrameCount() const { return frame_count.load(std::memory_order_relaxed); }
+    uint64_t GetDeadmanStopCount() const { return deadman_count.load(std::memory_order_relaxed); }
+    uint64_t GetSentCount(PTZCommandType type) const { return sent_by_type[(int)type].load(std::memory_order_relaxed); }
+
+    // Commands waiting in the queues plus axes pending in the mailbox.
+    // Only a snapshot, the sender keeps moving.
+    size_t GetQueueDepth() const {
+        return lanes.SizeApprox() + mailbox_depth.load(std::memory_order_relaxed);
+    }
+
+    // The camera's current pace in commands per second and its smoothed
+    // command latency in seconds, 0 while unknown or unlimited
+    double GetPacedRate();
+    double GetCommandLatency();
+
+    // How long the camera takes to act on commands, and forgetting that.
+    // Kept per camera, so shared with every other instance on it.
+    LatencySummary GetFeedbackLatency();
+    void ResetFeedbackLatency();
+
+private:
+    void Run();
+    bool Dispatch(const PTZCommand& command, const std::shared_ptr<SharedReceiver>& shared_recv);
+    bool DispatchBatch(const PTZCommand* commands, int count, const std::shared_ptr<SharedReceiver>& shared_recv);
+    void Enqueue(const PTZCommand& command, bool plan, std::chrono::steady_clock::time_point now);
+    void Halt();
+    void KeepAlive(const KeepaliveSettings& settings, std::chrono::steady_clock::time_point now);
+    void CountSent(const PTZCommand* commands, int count);
+
+    const NDIlib_v3* pNDILib;
+    CommandLanes lanes;
+    CommandMailbox mailbox;    // sender thread only
+    std::atomic<int> mailbox_depth;    // its pending count, for everyone else
+    PTZXmlWriter xml_writer;    // sender thread only
+    std::atomic<bool> batching;
+
+    SeqLock<TrajectorySettings> trajectory;
+    TrajectoryPlanner planner;    // sender thread only
+    std::chrono::steady_clock::time_point last_step;
+    std::chrono::steady_clock::time_point next_step;
+    std::atomic<double> command_rate;
+    std::atomic<double> command_burst;
+    std::atomic<bool> adaptive_rate;
+    std::atomic<double> control_rate;
+
+    SeqLock<KeepaliveSettings> keepalive;
+    std::chrono::steady_clock::time_point next_keepalive;
+    // Clock ticks of the last feed per command type
+    std::atomic<std::chrono::steady_clock::rep> fed_at[NumPTZCommandTypes];
+    // Last speeds the cook asked for, sent again by the keepalive. Sender thread only.
+    PTZCommand speeds[NumPTZCommandTypes];
+    uint32_t speeds_set;
+    uint32_t deadman_stopped;
+
+    // Identifies us when claiming control of a shared receiver
+    const uint32_t client_id;
+
+    std::mutex receiver_mutex;    // never held across an NDI call
+    std::shared_ptr<SharedReceiver> receiver;
+    std::atomic<bool> running;
+    std::atomic<bool> replay_requested;
+    std::atomic<bool> stop_requested;
+
+    std::thread worker;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    // Stamps submitted commands with their order, 0 is left for unstamped ones
+    std::atomic<uint64_t> next_sequence;
+
+    std::atomic<uint64_t> submitted_count;
+    std::atomic<uint64_t> sent_count;
+    std::atomic<uint64_t> conflated_count;
+    std::atomic<uint64_t> dropped_count;
+    std::atomic<uint64_t> blocked_count;    // refused because another instance has control
+    std::atomic<uint64_t> throttled_count;    // held back because the camera's token bucket was empty
+    std::atomic<uint64_t> frame_count;    // metadata frames the sent commands took
+    std::atomic<uint64_t> deadman_count;    // axes stopped because the cook went quiet
+    std::atomic<uint64_t> sent_by_type[NumPTZCommandTypes];
+};
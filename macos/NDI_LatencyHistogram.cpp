@@ -0,0 +1,94 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Lock-free log-linear latency histogram. Every power of two is split into
+ *    16 linear buckets, so any percentile is within about 6% of the real value
+ *    from a microsecond up to a minute, in a fixed block of counters.
+ */
+
+#include "NDI_LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+void LatencyHistogram::Record(uint64_t microseconds) {
+    buckets[GetBucket(microseconds)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_us.load(std::memory_order_relaxed);
+    while (microseconds > max && !max_us.compare_exchange_weak(max, microseconds, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    max_us.store(0, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::Summarize() const {
+    uint64_t counts[NumBuckets];
+    uint64_t count = 0;
+    for (int i = 0; i < NumBuckets; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        count += counts[i];
+    }
+
+    LatencySummary summary = { count, -1.0, -1.0, -1.0, -1.0 };
+    if (count == 0) {
+        return summary;
+    }
+
+    const uint64_t max = max_us.load(std::memory_order_relaxed);
+    summary.max = max / 1000.0;
+
+    // The smallest value at least this share of the samples are at or below
+    struct Percentile {
+        double share;
+        double LatencySummary::* field;
+    };
+    static const Percentile percentiles[] = {
+        { 0.50, &LatencySummary::p50 },
+        { 0.95, &LatencySummary::p95 },
+        { 0.99, &LatencySummary::p99 },
+    };
+
+    uint64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < NumBuckets && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3 && (double)seen >= std::ceil(percentiles[next].share * count)) {
+            // A bucket's top can be past anything actually recorded
+            summary.*percentiles[next].field = std::min(GetBucketTop(i), max) / 1000.0;
+            next++;
+        }
+    }
+    return summary;
+}
+
+int LatencyHistogram::GetBucket(uint64_t microseconds) {
+    if (microseconds < (uint64_t)SubBuckets) {
+        return (int)microseconds;
+    }
+
+    // Keep the top SubBits + 1 bits: the leading one picks the power of two,
+    // the rest the linear bucket within it
+    int shift = 0;
+    while ((microseconds >> shift) >= (uint64_t)(2 * SubBuckets)) {
+        shift++;
+    }
+    const int bucket = (shift + 1) * SubBuckets + (int)((microseconds >> shift) - SubBuckets);
+    return std::min(bucket, NumBuckets - 1);
+}
+
+uint64_t LatencyHistogram::GetBucketTop(int bucket) {
+    if (bucket < SubBuckets) {
+        return (uint64_t)bucket;
+    }
+    const int shift = bucket / SubBuckets - 1;
+    const uint64_t sub = (uint64_t)(bucket % SubBuckets + SubBuckets);
+    return ((sub + 1) << shift) - 1;
+}
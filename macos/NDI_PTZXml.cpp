@@ -0,0 +1,141 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Writes several PTZ commands as one metadata frame, the same XML the
+ *    NDIlib_recv_ptz_* calls send one element at a time. Fixed buffer,
+ *    nothing is allocated.
+ */
+
+#include "NDI_PTZXml.h"
+
+#include <math.h>
+#include <string.h>
+
+// Shortest text that reads back as the same float where the library has it
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+
+#ifndef __cpp_lib_to_chars
+// Without it numbers are written by hand in fixed point: snprintf follows
+// LC_NUMERIC, which may have it write a comma where the camera wants a point.
+// PTZ values are well within this.
+static const float max_written = 1e9f;
+// Enough for 9 significant digits, which any float reads back from, down to 1e-9
+static const int max_decimals = 18;
+// Sign, a digit, the point and the decimals
+static const int max_number_length = 3 + max_decimals;
+
+// Writes value with as few decimals as read back as the same float, and
+// returns the length
+static int FormatNumber(float value, char* text) {
+    const double magnitude = fabs((double)value);
+    uint64_t scale = 1;
+    uint64_t scaled = (uint64_t)(magnitude + 0.5);
+    int decimals = 0;
+    while (decimals < max_decimals && (float)((double)scaled / (double)scale) != (float)magnitude) {
+        scale *= 10;
+        decimals++;
+        scaled = (uint64_t)(magnitude * (double)scale + 0.5);
+    }
+    // Too small to show
+    if (scaled == 0) {
+        decimals = 0;
+    }
+
+    // Least significant digit first, at least one before the point
+    char digits[max_number_length];
+    int count = 0;
+    const bool negative = value < 0.f && scaled != 0;
+    do {
+        digits[count++] = (char)('0' + scaled % 10);
+        scaled /= 10;
+    } while (scaled != 0 || count <= decimals);
+
+    int size = 0;
+    if (negative) {
+        text[size++] = '-';
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        text[size++] = digits[i];
+        if (i == decimals && decimals > 0) {
+            text[size++] = '.';
+        }
+    }
+    text[size] = '\0';
+    return size;
+}
+#endif
+
+void PTZXmlWriter::Clear() {
+    length = 0;
+    buffer[0] = '\0';
+}
+
+bool PTZXmlWriter::Append(const PTZCommand& command) {
+    const int start = length;
+    bool written = false;
+
+    switch (command.type) {
+    case PTZCommandType::PanTilt: {
+        written = Write("<ntk_ptz_pan_tilt pan=\"") && WriteNumber(command.a) &&
+            Write("\" tilt=\"") && WriteNumber(command.b) && Write("\"/>");
+        break;
+    }
+    case PTZCommandType::PanTiltSpeed: {
+        written = Write("<ntk_ptz_pan_tilt_speed pan_speed=\"") && WriteNumber(command.a) &&
+            Write("\" tilt_speed=\"") && WriteNumber(command.b) && Write("\"/>");
+        break;
+    }
+    case PTZCommandType::Zoom: {
+        written = Write("<ntk_ptz_zoom zoom=\"") && WriteNumber(command.a) && Write("\"/>");
+        break;
+    }
+    case PTZCommandType::ZoomSpeed: {
+        written = Write("<ntk_ptz_zoom_speed zoom_speed=\"") && WriteNumber(command.a) && Write("\"/>");
+        break;
+    }
+    case PTZCommandType::Focus: {
+        written = Write("<ntk_ptz_focus mode=\"manual\" distance=\"") && WriteNumber(command.a) && Write("\"/>");
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (!written) {
+        length = start;
+        buffer[length] = '\0';
+    }
+    return written;
+}
+
+bool PTZXmlWriter::Write(const char* text) {
+    const size_t size = strlen(text);
+    if (length + size >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer + length, text, size + 1);
+    length += (int)size;
+    return true;
+}
+
+bool PTZXmlWriter::WriteNumber(float value) {
+    char* const end = buffer + sizeof(buffer) - 1;
+#ifdef __cpp_lib_to_chars
+    const std::to_chars_result result = std::to_chars(buffer + length, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    *result.ptr = '\0';
+    length = (int)(result.ptr - buffer);
+    return true;
+#else
+    if (!(value > -max_written && value < max_written) || end - (buffer + length) < max_number_length) {
+        return false;
+    }
+    length += FormatNumber(value, buffer + length);
+    return true;
+#endif
+}
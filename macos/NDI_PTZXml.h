@@ -0,0 +1,42 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Writes several PTZ commands as one metadata frame, the same XML the
+ *    NDIlib_recv_ptz_* calls send one element at a time. Fixed buffer,
+ *    nothing is allocated.
+ */
+
+#pragma once
+
+#include "NDI_CommandQueue.h"
+
+#include <stdint.h>
+
+class PTZXmlWriter
+{
+public:
+    // Commands that can be written. Focus speed and exposure keep their SDK calls.
+    static const uint32_t Batched = (1u << (int)PTZCommandType::PanTilt) | (1u << (int)PTZCommandType::PanTiltSpeed) |
+        (1u << (int)PTZCommandType::Zoom) | (1u << (int)PTZCommandType::ZoomSpeed) | (1u << (int)PTZCommandType::Focus);
+
+    static bool Writes(PTZCommandType type) { return (Batched & (1u << (int)type)) != 0; }
+
+    PTZXmlWriter() { Clear(); }
+
+    void Clear();
+
+    // Adds the command's element. False, leaving the frame as it was,
+    // if it can't be written or doesn't fit.
+    bool Append(const PTZCommand& command);
+
+    // Null terminated. Not const because the frame NDI sends points at it.
+    char* GetData() { return buffer; }
+    int GetLength() const { return length; }
+
+private:
+    bool Write(const char* text);
+    bool WriteNumber(float value);
+
+    // Every batched element at once takes well under this
+    char buffer[512];
+    int length;
+};
@@ -0,0 +1,83 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Closed-loop positioning. Steers pan, tilt and zoom towards their targets
+ *    with speed commands, from the position the camera reports back.
+ */
+
+#pragma once
+
+#include "NDI_CommandSender.h"
+#include "NDI_Connection.h"
+#include "NDI_SeqLock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Commands the control loop sends in place of the pan, tilt and zoom parameters
+constexpr uint32_t ClosedLoopCommands = (1u << (int)PTZCommandType::PanTilt) | (1u << (int)PTZCommandType::PanTiltSpeed) |
+    (1u << (int)PTZCommandType::Zoom) | (1u << (int)PTZCommandType::ZoomSpeed);
+
+struct PIDGains {
+    double kp;
+    double ki;
+    double kd;
+};
+
+// One axis. Output is a speed in [-1, 1].
+class PIDController
+{
+public:
+    PIDController() { Reset(); }
+
+    void Reset();
+    // dt is the time since the last position it was given
+    double Update(double target, double position, double dt, const PIDGains& gains);
+
+private:
+    double integral;
+    double last_position;
+    bool has_last;
+};
+
+class PositionController
+{
+public:
+    PositionController(CommandSender& sender, CameraConnection& connection);
+    ~PositionController();
+
+    // Cook thread. Stopping halts the head before returning.
+    void Start();
+    void Stop();
+    bool IsRunning() const { return running.load(); }
+
+    // Cook thread, picked up on the next control tick
+    void SetTarget(double pan, double tilt, double zoom, const PIDGains& gains);
+
+    // Control ticks per second, may be changed while running
+    void SetControlRate(double rate);
+
+private:
+    struct Settings {
+        double pan;
+        double tilt;
+        double zoom;
+        PIDGains gains;
+    };
+
+    void Run();
+    void SendSpeeds(float pan, float tilt, float zoom);
+
+    CommandSender& sender;
+    CameraConnection& connection;
+
+    SeqLock<Settings> settings;
+
+    // Control thread only
+    float sent_pan_tilt[2];
+    float sent_zoom;
+
+    std::atomic<double> control_rate;
+    std::atomic<bool> running;
+    std::thread worker;
+};
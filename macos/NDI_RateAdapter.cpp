@@ -0,0 +1,113 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Finds the fastest command rate a camera keeps up with. It is fed the
+ *    time from each command to the camera reporting its axis moving, and the
+ *    rate is adapted AIMD-style: additive increase while that latency holds,
+ *    multiplicative decrease once it grows.
+ */
+
+#include "NDI_RateAdapter.h"
+
+#include <algorithm>
+
+// Bounds of the adapted rate. The top one stands in for an unlimited ceiling.
+static const double min_rate = 1.0;
+static const double max_rate = 200.0;
+
+// Where a camera starts out. Starting at the ceiling would make an overloaded
+// camera's latency look like its base, so the rate works its way up instead.
+static const double initial_rate = 10.0;
+
+// Commands per second added per answered command, which is about one per round trip
+static const double rate_increase = 1.0;
+static const double rate_decrease = 0.5;
+
+// Latency counts as grown once the smoothed one is this far above the base
+static const double latency_growth = 1.5;
+static const double latency_margin = 0.005;
+
+// Backs off once the latency was found grown this many samples in a row, or
+// this many commands in a row went unanswered. A single straggler doesn't.
+static const int slow_limit = 3;
+static const int missed_limit = 3;
+
+// The base is the lowest latency over this long, so it follows a camera
+// or network that got slower for good
+static const std::chrono::seconds base_window(10);
+
+RateAdapter::RateAdapter() : rate(0.0),
+    smoothed_latency(0.0), base_latency(0.0), window_min(0.0), holdoff(0), slow(0), missed(0)
+{
+}
+
+double RateAdapter::GetRate(double ceiling) {
+    if (ceiling <= 0.0) {
+        ceiling = max_rate;
+    }
+    if (rate <= 0.0) {
+        rate = initial_rate;
+    }
+    rate = std::max(std::min(rate, ceiling), std::min(min_rate, ceiling));
+    return rate;
+}
+
+void RateAdapter::Answered(double latency, std::chrono::steady_clock::time_point now) {
+    missed = 0;
+    Sample(latency, now);
+}
+
+void RateAdapter::Unanswered() {
+    // Nothing to go by yet, the camera may not report its position at all.
+    // It stays at the starting rate rather than being pushed either way.
+    if (smoothed_latency <= 0.0) {
+        return;
+    }
+
+    if (holdoff > 0) {
+        holdoff--;
+        return;
+    }
+    if (++missed >= missed_limit) {
+        Decrease();
+    }
+}
+
+void RateAdapter::Sample(double latency, std::chrono::steady_clock::time_point now) {
+    if (smoothed_latency <= 0.0) {
+        smoothed_latency = base_latency = window_min = std::max(latency, 1e-6);
+        window_start = now;
+        return;
+    }
+
+    smoothed_latency += (latency - smoothed_latency) / 8.0;
+
+    window_min = std::min(window_min, latency);
+    base_latency = std::min(base_latency, latency);
+    if (now - window_start > base_window) {
+        base_latency = window_min;
+        window_min = latency;
+        window_start = now;
+    }
+
+    if (holdoff > 0) {
+        holdoff--;
+        return;
+    }
+
+    if (smoothed_latency <= base_latency * latency_growth + latency_margin) {
+        slow = 0;
+        rate = std::min(rate + rate_increase, max_rate);
+    }
+    // Grown: held where it is until that's no one-off
+    else if (++slow >= slow_limit) {
+        Decrease();
+    }
+}
+
+void RateAdapter::Decrease() {
+    rate = std::max(rate * rate_decrease, min_rate);
+    // About as long as the smoothed latency takes to follow
+    holdoff = 8;
+    slow = 0;
+    missed = 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Finds the fastest command rate a camera keeps up with. It is fed the
+ *    time from each command to the camera reporting its axis moving, and the
+ *    rate is adapted AIMD-style: additive increase while that latency holds,
+ *    multiplicative decrease once it grows.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+// Not thread safe, the owner locks
+class RateAdapter
+{
+public:
+    RateAdapter();
+
+    // Rate to pace commands at now, never above ceiling. Cameras that
+    // never answer, having no position reports, stay at the starting rate.
+    double GetRate(double ceiling);
+
+    // The camera acted on a command latency seconds after it went out
+    void Answered(double latency, std::chrono::steady_clock::time_point now);
+
+    // The camera never showed acting on a command. Backs off once several
+    // in a row went unanswered, one alone is more likely a move to where
+    // the camera already was than a camera falling behind.
+    void Unanswered();
+
+    // Last rate handed out, 0 if none yet
+    double GetCurrentRate() const { return rate; }
+
+    // Smoothed command to report latency in seconds, 0 until measured
+    double GetLatency() const { return smoothed_latency; }
+
+private:
+    void Sample(double latency, std::chrono::steady_clock::time_point now);
+    void Decrease();
+
+    double rate;
+
+    double smoothed_latency;
+    // Lowest latency of the last window or two, what the camera does unloaded
+    double base_latency;
+    double window_min;
+    std::chrono::steady_clock::time_point window_start;
+
+    // Samples to let pass after a decrease, so one slow spell backs off once
+    int holdoff;
+    // Samples in a row that found the latency grown, and commands in a row
+    // that went unanswered
+    int slow;
+    int missed;
+};
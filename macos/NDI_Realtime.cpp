@@ -0,0 +1,22 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Timing of the control threads, which have to tick on time whatever
+ *    TouchDesigner's frame rate is doing.
+ */
+
+#include "NDI_Realtime.h"
+
+#include <pthread.h>
+#include <pthread/qos.h>
+
+RealtimeThreadScope::RealtimeThreadScope(ThreadPriority priority)
+{
+    // Timer resolution is fine on macOS, only the scheduling class matters
+    pthread_set_qos_class_self_np(
+        priority == ThreadPriority::ControlLoop ? QOS_CLASS_USER_INTERACTIVE : QOS_CLASS_USER_INITIATED, 0);
+}
+
+RealtimeThreadScope::~RealtimeThreadScope()
+{
+    pthread_set_qos_class_self_np(QOS_CLASS_DEFAULT, 0);
+}
@@ -0,0 +1,45 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Timing of the control threads, which have to tick on time whatever
+ *    TouchDesigner's frame rate is doing.
+ */
+
+#pragma once
+
+#include <chrono>
+
+// How far above TouchDesigner's own threads a control thread is raised
+enum class ThreadPriority {
+    // The fixed-rate control loop: short, on a strict clock
+    ControlLoop,
+    // Command senders, up to one per bank camera and mostly waiting in
+    // NDI calls: ahead of the frame work, but never starving it
+    Sender,
+};
+
+// Puts the calling thread in a higher QoS class for as long as it lives,
+// so it is scheduled ahead of background work
+class RealtimeThreadScope
+{
+public:
+    explicit RealtimeThreadScope(ThreadPriority priority);
+    ~RealtimeThreadScope();
+
+    RealtimeThreadScope(const RealtimeThreadScope&) = delete;
+    RealtimeThreadScope& operator=(const RealtimeThreadScope&) = delete;
+};
+
+// Length of one tick at rate Hz
+inline std::chrono::steady_clock::duration GetTickPeriod(double rate) {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+}
+
+// Moves next_tick on by one period. Ticks stay on their grid when one is
+// served late, but after a stall the grid restarts instead of bursting.
+inline void AdvanceTick(std::chrono::steady_clock::time_point& next_tick, std::chrono::steady_clock::duration period,
+    std::chrono::steady_clock::time_point now) {
+    next_tick += period;
+    if (next_tick <= now) {
+        next_tick = now + period;
+    }
+}
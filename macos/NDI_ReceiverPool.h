@@ -0,0 +1,104 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Receivers shared by every instance that targets the same camera, so ten
+ *    panels driving one head still cost the camera a single NDI connection.
+ */
+
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+#include "NDI_CameraFeedback.h"
+#include "NDI_RateAdapter.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// One NDI connection to a camera. Destroyed with the last reference to it.
+class SharedReceiver
+{
+public:
+    SharedReceiver(const NDIlib_v3* lib, NDIlib_recv_instance_t recv, const std::string& url);
+    ~SharedReceiver();
+
+    NDIlib_recv_instance_t GetHandle() const { return pNDI_recv; }
+    const std::string& GetURL() const { return url; }
+
+    // Only one client drives the camera at a time. Whoever sends first gets
+    // control and keeps it for as long as it keeps sending; the others are
+    // refused until it has been quiet for a whole lease.
+    bool ClaimControl(uint32_t client_id);
+
+    // Token bucket shared by every sender on this camera: up to burst commands
+    // back to back, refilled at rate per second. Takes a token and returns zero
+    // if a command may go now, otherwise how long until the next token.
+    // A rate of 0 means unlimited. Adaptive, rate is only the ceiling and the
+    // bucket refills as fast as the camera's answers say it keeps up.
+    std::chrono::steady_clock::duration TakeToken(double rate, double burst, bool adaptive);
+
+    // Rate the bucket refilled at last and the camera's command latency in
+    // seconds, the adapter's smoothed view of the feedback latency, for
+    // display. Both 0 until known.
+    double GetPacedRate();
+    double GetCommandLatency();
+
+    // Where the camera last said it is
+    CameraPosition GetPosition() const { return feedback.GetPosition(); }
+
+    // Time from a command to the camera's first report of its axes moving,
+    // over everyone's commands. See CameraFeedback::CommandSent. Adaptive
+    // pacing goes by the same timings.
+    void CommandSent(std::chrono::steady_clock::time_point sent_at, uint32_t axes) { feedback.CommandSent(sent_at, axes); }
+    LatencySummary GetLatencySummary() const { return feedback.GetLatencySummary(); }
+    void ResetLatency() { feedback.ResetLatency(); }
+
+private:
+    const NDIlib_v3* pNDILib;
+    NDIlib_recv_instance_t pNDI_recv;
+    std::string url;
+
+    std::mutex control_mutex;
+    uint32_t controller_id;
+    std::chrono::steady_clock::time_point control_until;
+
+    std::mutex bucket_mutex;
+    // Starts full, capped to the burst on first use
+    double tokens;
+    std::chrono::steady_clock::time_point refilled_at;
+    double paced_rate;
+    RateAdapter rate_adapter;
+
+    // One capture thread per connection, however many instances share it
+    CameraFeedback feedback;
+};
+
+class ReceiverPool
+{
+public:
+    ReceiverPool() : pNDILib(nullptr) {}
+
+    // Entry points of the loaded library, set once by the runtime
+    void SetLib(const NDIlib_v3* lib) { pNDILib = lib; }
+
+    // Returns the receiver for this source, connecting on first use.
+    // Null if the receiver couldn't be created.
+    std::shared_ptr<SharedReceiver> Acquire(const std::string& url, const std::string& name, bool receive_video);
+
+    // Replaces a receiver that stopped working. If another user of the same
+    // camera already did, their new receiver is returned instead.
+    std::shared_ptr<SharedReceiver> Reconnect(const std::shared_ptr<SharedReceiver>& stale,
+        const std::string& url, const std::string& name, bool receive_video);
+
+private:
+    std::shared_ptr<SharedReceiver> Create(const std::string& url, const std::string& name, bool receive_video);
+
+    const NDIlib_v3* pNDILib;
+    std::mutex pool_mutex;
+
+    // Metadata-only and full-bandwidth connections to the same camera can't be shared
+    std::map<std::pair<std::string, bool>, std::weak_ptr<SharedReceiver>> receivers;
+};
@@ -0,0 +1,80 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Process-wide NDI runtime. Every CHOP instance holds a reference: the first
+ *    one initialises NDI and starts the shared source finder, the last one
+ *    tears both down again.
+ */
+
+#include "NDI_Runtime.h"
+
+#include <stdio.h>
+#include <dlfcn.h>
+
+std::mutex NDIRuntime::instance_mutex;
+NDIRuntime* NDIRuntime::instance = nullptr;
+int NDIRuntime::ref_count = 0;
+
+NDIRuntime* NDIRuntime::Acquire() {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (ref_count++ == 0) {
+        instance = new NDIRuntime();
+    }
+    return instance;
+}
+
+void NDIRuntime::Release() {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (ref_count == 0) {
+        return;
+    }
+    if (--ref_count == 0) {
+        delete instance;
+        instance = nullptr;
+    }
+}
+
+NDIRuntime::NDIRuntime() : pNDILib(nullptr), initialized(false)
+{
+    std::string ndi_path = "/usr/local/lib/libndi.dylib";
+
+    void *hNDILib = ::dlopen(ndi_path.c_str(), RTLD_LOCAL | RTLD_LAZY);
+
+    // The main NDI entry point for dynamic loading if we got the library
+    NDIlib_v3* (*NDIlib_v3_load)(void) = NULL;
+    if (hNDILib)
+        *((void**)&NDIlib_v3_load) = ::dlsym(hNDILib, "NDIlib_v3_load");
+
+    if (!NDIlib_v3_load)
+    {
+        printf("Please re-install the NewTek NDI Runtimes to use this application.");
+        return;
+    }
+
+    // Lets get all of the DLL entry points
+    pNDILib = NDIlib_v3_load();
+
+    // We can now run as usual
+    if (!pNDILib->initialize())
+    {    // Cannot run NDI. Most likely because the CPU is not sufficient (see SDK documentation).
+        // you can check this directly with a call to NDIlib_is_supported_CPU()
+        printf("Cannot run NDI\n");
+        if (!pNDILib->NDIlib_is_supported_CPU) {
+            printf("CPU is not supported\n");
+        }
+        return;
+    }
+    printf("NDI Initialization is succesfull\n");
+    initialized = true;
+
+    receivers.SetLib(pNDILib);
+    discovery.Start(pNDILib);
+}
+
+NDIRuntime::~NDIRuntime()
+{
+    // The finder has to go before the library it lives in
+    discovery.Stop();
+    if (initialized) {
+        pNDILib->NDIlib_destroy();
+    }
+}
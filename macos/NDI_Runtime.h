@@ -0,0 +1,48 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Process-wide NDI runtime. Every CHOP instance holds a reference: the first
+ *    one initialises NDI and starts the shared source finder, the last one
+ *    tears both down again.
+ */
+
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+#include "NDI_SourceDiscovery.h"
+#include "NDI_ReceiverPool.h"
+
+#include <mutex>
+#include <string>
+
+class NDIRuntime
+{
+public:
+    // Takes a reference on the runtime, creating it on first use. Never returns null.
+    static NDIRuntime* Acquire();
+    // Drops a reference taken with Acquire().
+    static void Release();
+
+    bool IsInitialized() const { return initialized; }
+
+    // Entry points of the dynamically loaded library, null if it isn't installed
+    const NDIlib_v3* GetLib() const { return pNDILib; }
+
+    // One finder for the whole process, all instances read its snapshots
+    SourceDiscovery& GetDiscovery() { return discovery; }
+
+    // Instances on the same camera share one connection to it
+    ReceiverPool& GetReceivers() { return receivers; }
+
+private:
+    NDIRuntime();
+    ~NDIRuntime();
+
+    NDIlib_v3* pNDILib;
+    bool initialized;
+    SourceDiscovery discovery;
+    ReceiverPool receivers;
+
+    static std::mutex instance_mutex;
+    static NDIRuntime* instance;
+    static int ref_count;
+};
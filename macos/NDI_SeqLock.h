@@ -0,0 +1,61 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Single writer, many readers snapshot. The writer never waits and readers
+ *    never block it, they retry the rare read that overlapped a write.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// T must be trivially copyable
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock() : sequence(0) {
+        for (std::atomic<uint64_t>& word : data) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer thread only
+    void Store(const T& value) {
+        uint64_t words[NumWords] = {};
+        memcpy(words, &value, sizeof(T));
+
+        // Odd while the write is in progress
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < NumWords; i++) {
+            data[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T Load() const {
+        uint64_t words[NumWords];
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (int i = 0; i < NumWords; i++) {
+                words[i] = data[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    static const int NumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> data[NumWords];
+};
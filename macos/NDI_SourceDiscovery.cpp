@@ -0,0 +1,108 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Background NDI source discovery. The finder runs on its own thread and
+ *    publishes immutable snapshots of the source list, so nothing on the
+ *    cook thread ever waits for the network.
+ */
+
+#include "NDI_SourceDiscovery.h"
+
+#include <stdio.h>
+
+SourceDiscovery::SourceDiscovery() : pNDILib(nullptr), running(false), sources(std::make_shared<NDISourceList>()), time_to_first_source_us(-1)
+{
+}
+
+SourceDiscovery::~SourceDiscovery()
+{
+    Stop();
+}
+
+void SourceDiscovery::Start(const NDIlib_v3* lib) {
+    if (running.exchange(true)) {
+        return;
+    }
+    pNDILib = lib;
+    {
+        // WaitForSources reads it under the lock
+        std::lock_guard<std::mutex> lock(sources_mutex);
+        start_time = std::chrono::steady_clock::now();
+    }
+    worker = std::thread(&SourceDiscovery::Run, this);
+}
+
+void SourceDiscovery::Stop() {
+    running.store(false);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+std::shared_ptr<const NDISourceList> SourceDiscovery::GetSources() const {
+    std::lock_guard<std::mutex> lock(sources_mutex);
+    return sources;
+}
+
+std::shared_ptr<const NDISourceList> SourceDiscovery::WaitForSources(std::chrono::steady_clock::duration timeout) const {
+    std::unique_lock<std::mutex> lock(sources_mutex);
+    if (running.load()) {
+        sources_published.wait_until(lock, start_time + timeout, [this] { return !sources->empty(); });
+    }
+    return sources;
+}
+
+double SourceDiscovery::GetTimeToFirstSource() const {
+    const int64_t us = time_to_first_source_us.load(std::memory_order_relaxed);
+    return us < 0 ? -1.0 : us / 1000.0;
+}
+
+void SourceDiscovery::Run() {
+    const NDIlib_find_create_t NDI_find_create_desc = { true, NULL };
+    NDIlib_find_instance_t pNDI_find = pNDILib->NDIlib_find_create_v2(&NDI_find_create_desc);
+    if (!pNDI_find) {
+        printf("Cannot create NDI finder\n");
+        return;
+    }
+
+    while (running.load()) {
+        // Keep the wait short so Stop() never has to wait long for us
+        if (!pNDILib->NDIlib_find_wait_for_sources(pNDI_find, 250 /* milliseconds */)) {
+            continue;
+        }
+
+        uint32_t no_sources = 0;
+        const NDIlib_source_t* p_sources = pNDILib->NDIlib_find_get_current_sources(pNDI_find, &no_sources);
+        Publish(p_sources, no_sources);
+    }
+
+    pNDILib->NDIlib_find_destroy(pNDI_find);
+}
+
+void SourceDiscovery::Publish(const NDIlib_source_t* p_sources, uint32_t no_sources) {
+    // The SDK owns p_sources and frees it on the next query, so take copies
+    std::shared_ptr<NDISourceList> list = std::make_shared<NDISourceList>();
+    list->reserve(no_sources);
+
+    printf("Network sources (%u found).\n", no_sources);
+    for (uint32_t i = 0; i < no_sources; i++) {
+        NDISourceInfo source;
+        source.name = p_sources[i].p_ndi_name ? p_sources[i].p_ndi_name : "";
+        source.url = p_sources[i].p_url_address ? p_sources[i].p_url_address : "";
+        list->push_back(source);
+
+        printf("%u. %s\t\t", i + 1, source.name.c_str());
+        printf("%s\n", source.url.c_str());
+    }
+
+    if (no_sources > 0 && time_to_first_source_us.load(std::memory_order_relaxed) < 0) {
+        const std::chrono::microseconds elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+        time_to_first_source_us.store(elapsed.count(), std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sources_mutex);
+        sources = list;
+    }
+    sources_published.notify_all();
+}
@@ -0,0 +1,62 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Background NDI source discovery. The finder runs on its own thread and
+ *    publishes immutable snapshots of the source list, so nothing on the
+ *    cook thread ever waits for the network.
+ */
+
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct NDISourceInfo {
+    std::string name;
+    std::string url;
+};
+
+typedef std::vector<NDISourceInfo> NDISourceList;
+
+class SourceDiscovery
+{
+public:
+    SourceDiscovery();
+    ~SourceDiscovery();
+
+    void Start(const NDIlib_v3* lib);
+    void Stop();
+
+    // Latest snapshot, never null. Cheap to call from any thread.
+    std::shared_ptr<const NDISourceList> GetSources() const;
+
+    // Same, but while nothing was found yet waits for the first source, up to
+    // timeout after Start(). Only the first callers after startup ever wait.
+    std::shared_ptr<const NDISourceList> WaitForSources(std::chrono::steady_clock::duration timeout) const;
+
+    // Milliseconds from Start() until the first source showed up, -1 until then
+    double GetTimeToFirstSource() const;
+
+private:
+    void Run();
+    void Publish(const NDIlib_source_t* p_sources, uint32_t no_sources);
+
+    const NDIlib_v3* pNDILib;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    mutable std::mutex sources_mutex;
+    mutable std::condition_variable sources_published;
+    std::shared_ptr<const NDISourceList> sources;
+
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<int64_t> time_to_first_source_us;
+};
@@ -0,0 +1,289 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Jerk-limited (S-curve) moves for absolute pan, tilt, zoom and focus.
+ *    A new target becomes a stream of setpoints instead of one jump, and a
+ *    target changed mid-move is blended into from the current motion.
+ */
+
+#include "NDI_TrajectoryPlanner.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Moves are integrated in steps no longer than this, whatever the command rate
+static const double max_substep = 0.005;
+
+// Bisection steps when picking the jerk of a substep
+static const int jerk_iterations = 24;
+
+// Where the axis comes to rest, relative to now and in the direction of
+// travel, if it brakes as hard as the limits allow from velocity v and
+// acceleration a: jerk down to full deceleration, hold it, and jerk back
+// up to reach zero acceleration just as the velocity reaches zero.
+// Never negative, backing away from the target can't overshoot it.
+static double StoppingDistance(double v, double a, const MotionLimits& limits) {
+    const double A = limits.acceleration;
+    const double J = limits.jerk;
+
+    // Speeding up towards the target or moving away from it, the
+    // deceleration needed to end at rest with zero acceleration
+    const double squared = J * v + 0.5 * a * a;
+    if (squared <= 0.0) {
+        // Moving away, and ramping the acceleration off never turns it around
+        return 0.0;
+    }
+    double a1 = -std::sqrt(squared);
+
+    // Braking harder than that already: ease off now, the axis comes to
+    // rest before the acceleration is back to zero
+    if (a < a1) {
+        const double t = (-a - std::sqrt(std::max(0.0, a * a - 2.0 * J * v))) / J;
+        return std::max(0.0, v * t + 0.5 * a * t * t + J * t * t * t / 6.0);
+    }
+
+    double hold = 0.0;
+    if (a1 < -A) {
+        a1 = -A;
+        hold = (v + (a * a - 2.0 * A * A) / (2.0 * J)) / A;
+    }
+
+    // Ramp down to a1, hold it, ramp back up to zero
+    double distance = 0.0;
+    const double t1 = (a - a1) / J;
+    distance += v * t1 + 0.5 * a * t1 * t1 - J * t1 * t1 * t1 / 6.0;
+    v += a * t1 - 0.5 * J * t1 * t1;
+
+    distance += v * hold + 0.5 * a1 * hold * hold;
+    v += a1 * hold;
+
+    const double t3 = -a1 / J;
+    distance += v * t3 + 0.5 * a1 * t3 * t3 + J * t3 * t3 * t3 / 6.0;
+    return std::max(0.0, distance);
+}
+
+// Whether, after a substep of jerk j from velocity v and acceleration a
+// along the way to a target distance ahead, the axis can still stop in
+// time and stay within the velocity limit
+static bool IsSafe(double distance, double v, double a, double j, double h, const MotionLimits& limits) {
+    const double moved = v * h + 0.5 * a * h * h + j * h * h * h / 6.0;
+    const double v_next = v + a * h + 0.5 * j * h * h;
+    const double a_next = a + j * h;
+
+    // Still speeding up, the velocity overshoots by what ramping that off adds
+    const double v_peak = v_next + (a_next > 0.0 ? a_next * a_next / (2.0 * limits.jerk) : 0.0);
+    if (v_peak > limits.velocity * (1.0 + 1e-9)) {
+        return false;
+    }
+    return moved + StoppingDistance(v_next, a_next, limits) <= distance;
+}
+
+void TrajectoryAxis::Reset() {
+    position = velocity = acceleration = target = 0.0;
+    initialized = false;
+    moving = false;
+}
+
+void TrajectoryAxis::SetRange(double min, double max) {
+    range_min = min;
+    range_max = max;
+}
+
+void TrajectoryAxis::SetTarget(double new_target) {
+    target = std::max(range_min, std::min(range_max, new_target));
+    if (!initialized) {
+        position = target;
+        initialized = true;
+        return;
+    }
+    moving = position != target || velocity != 0.0;
+}
+
+bool TrajectoryAxis::Step(double dt, const MotionLimits& limits) {
+    if (!moving) {
+        return false;
+    }
+
+    while (dt > 0.0 && moving) {
+        const double h = std::min(dt, max_substep);
+        dt -= h;
+
+        // Everything below is in the direction of the target
+        const double error = target - position;
+        const double distance = std::fabs(error);
+
+        // Close enough that a single substep at full jerk settles it. Closer
+        // in, the substeps are too coarse to do better than dither around it.
+        const double settle = limits.jerk * max_substep;
+        if (distance <= std::max(1e-6, settle * max_substep * max_substep) &&
+            std::fabs(velocity) <= settle * max_substep && std::fabs(acceleration) <= settle) {
+            Finish();
+            break;
+        }
+        const double direction = error > 0.0 ? 1.0 : (error < 0.0 ? -1.0 : (velocity > 0.0 ? -1.0 : 1.0));
+        const double v = velocity * direction;
+        const double a = acceleration * direction;
+
+        // The hardest push towards the target that still lets the axis stop
+        // on it. Braking as hard as allowed always stays safe once the move
+        // is, so this only falls back to it after a target came too close.
+        double low = std::max(-limits.jerk, (-limits.acceleration - a) / h);
+        double high = std::min(limits.jerk, (limits.acceleration - a) / h);
+        double j = low;
+        if (IsSafe(distance, v, a, high, h, limits)) {
+            j = high;
+        }
+        else if (IsSafe(distance, v, a, low, h, limits)) {
+            for (int i = 0; i < jerk_iterations; i++) {
+                const double mid = 0.5 * (low + high);
+                if (IsSafe(distance, v, a, mid, h, limits)) {
+                    low = mid;
+                }
+                else {
+                    high = mid;
+                }
+            }
+            j = low;
+        }
+
+        position += direction * (v * h + 0.5 * a * h * h + j * h * h * h / 6.0);
+        velocity = direction * (v + a * h + 0.5 * j * h * h);
+        acceleration = direction * (a + j * h);
+
+        // The setpoint never passes the target, nor leaves the axis. Only a
+        // target set too close to stop in front of gets here.
+        const bool passed = direction > 0.0 ? position > target : position < target;
+        if (passed) {
+            Finish();
+            break;
+        }
+        if (position < range_min || position > range_max) {
+            position = std::max(range_min, std::min(range_max, position));
+            velocity = acceleration = 0.0;
+        }
+    }
+    return true;
+}
+
+void TrajectoryAxis::Finish() {
+    position = target;
+    velocity = acceleration = 0.0;
+    moving = false;
+}
+
+void TrajectoryAxis::Halt() {
+    target = position;
+    velocity = acceleration = 0.0;
+    moving = false;
+}
+
+TrajectoryPlanner::TrajectoryPlanner() {
+    // What NDI takes: pan and tilt from -1 to 1, zoom and focus from 0 to 1
+    axes[(int)PlannedAxis::Pan].SetRange(-1.0, 1.0);
+    axes[(int)PlannedAxis::Tilt].SetRange(-1.0, 1.0);
+    axes[(int)PlannedAxis::Zoom].SetRange(0.0, 1.0);
+    axes[(int)PlannedAxis::Focus].SetRange(0.0, 1.0);
+}
+
+bool TrajectoryPlanner::Plans(PTZCommandType type) {
+    return type == PTZCommandType::PanTilt || type == PTZCommandType::Zoom || type == PTZCommandType::Focus;
+}
+
+void TrajectoryPlanner::SetTarget(const PTZCommand& command) {
+    switch (command.type) {
+    case PTZCommandType::PanTilt:
+        axes[(int)PlannedAxis::Pan].SetTarget(command.a);
+        axes[(int)PlannedAxis::Tilt].SetTarget(command.b);
+        // Goes out with the next step even if it's a jump rather than a move
+        pending[(int)PlannedAxis::Pan] = pending[(int)PlannedAxis::Tilt] = true;
+        target_sequence[(int)PlannedAxis::Pan] = target_sequence[(int)PlannedAxis::Tilt] = command.sequence;
+        break;
+    case PTZCommandType::Zoom:
+        axes[(int)PlannedAxis::Zoom].SetTarget(command.a);
+        pending[(int)PlannedAxis::Zoom] = true;
+        target_sequence[(int)PlannedAxis::Zoom] = command.sequence;
+        break;
+    case PTZCommandType::Focus:
+        axes[(int)PlannedAxis::Focus].SetTarget(command.a);
+        pending[(int)PlannedAxis::Focus] = true;
+        target_sequence[(int)PlannedAxis::Focus] = command.sequence;
+        break;
+    default:
+        break;
+    }
+}
+
+bool TrajectoryPlanner::IsMoving() const {
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        if (pending[i] || axes[i].IsMoving()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int TrajectoryPlanner::Step(double dt, const MotionLimits limits[NumPlannedAxes], PTZCommand* out) {
+    bool moved[NumPlannedAxes];
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        moved[i] = axes[i].Step(dt, limits[i]) || pending[i];
+        pending[i] = false;
+    }
+    return Collect(moved, out);
+}
+
+int TrajectoryPlanner::Finish(PTZCommand* out) {
+    bool moved[NumPlannedAxes];
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        moved[i] = pending[i] || axes[i].IsMoving();
+        pending[i] = false;
+        axes[i].Finish();
+    }
+    return Collect(moved, out);
+}
+
+void TrajectoryPlanner::Halt(uint32_t commands, uint64_t sequence) {
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        if (Covers(commands, (PlannedAxis)i) && target_sequence[i] < sequence) {
+            axes[i].Halt();
+            pending[i] = false;
+        }
+    }
+}
+
+void TrajectoryPlanner::Forget(uint32_t commands, uint64_t sequence) {
+    for (int i = 0; i < NumPlannedAxes; i++) {
+        if (Covers(commands, (PlannedAxis)i) && target_sequence[i] < sequence) {
+            axes[i].Reset();
+            pending[i] = false;
+        }
+    }
+}
+
+bool TrajectoryPlanner::Covers(uint32_t commands, PlannedAxis axis) {
+    switch (axis) {
+    case PlannedAxis::Pan:
+    case PlannedAxis::Tilt:
+        return (commands & (1u << (int)PTZCommandType::PanTilt)) != 0;
+    case PlannedAxis::Zoom:
+        return (commands & (1u << (int)PTZCommandType::Zoom)) != 0;
+    case PlannedAxis::Focus:
+        return (commands & (1u << (int)PTZCommandType::Focus)) != 0;
+    }
+    return false;
+}
+
+int TrajectoryPlanner::Collect(const bool moved[NumPlannedAxes], PTZCommand* out) const {
+    int count = 0;
+    if (moved[(int)PlannedAxis::Pan] || moved[(int)PlannedAxis::Tilt]) {
+        out[count] = MakeCommand(PTZCommandType::PanTilt, (float)axes[(int)PlannedAxis::Pan].GetPosition(), (float)axes[(int)PlannedAxis::Tilt].GetPosition());
+        out[count++].sequence = target_sequence[(int)PlannedAxis::Pan];
+    }
+    if (moved[(int)PlannedAxis::Zoom]) {
+        out[count] = MakeCommand(PTZCommandType::Zoom, (float)axes[(int)PlannedAxis::Zoom].GetPosition());
+        out[count++].sequence = target_sequence[(int)PlannedAxis::Zoom];
+    }
+    if (moved[(int)PlannedAxis::Focus]) {
+        out[count] = MakeCommand(PTZCommandType::Focus, (float)axes[(int)PlannedAxis::Focus].GetPosition());
+        out[count++].sequence = target_sequence[(int)PlannedAxis::Focus];
+    }
+    return count;
+}
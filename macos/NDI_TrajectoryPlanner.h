@@ -0,0 +1,107 @@
+/*
+ * // NDI PTZ Camera controller \\
+ *    Jerk-limited (S-curve) moves for absolute pan, tilt, zoom and focus.
+ *    A new target becomes a stream of setpoints instead of one jump, and a
+ *    target changed mid-move is blended into from the current motion.
+ */
+
+#pragma once
+
+#include "NDI_CommandQueue.h"
+
+// Per axis, in units per second, per second squared and per second cubed
+struct MotionLimits {
+    double velocity;
+    double acceleration;
+    double jerk;
+};
+
+// Planned axes, in limit order
+enum class PlannedAxis : int {
+    Pan,
+    Tilt,
+    Zoom,
+    Focus,
+};
+
+const int NumPlannedAxes = (int)PlannedAxis::Focus + 1;
+
+struct TrajectorySettings {
+    bool enabled;
+    MotionLimits limits[NumPlannedAxes];
+};
+
+class TrajectoryAxis
+{
+public:
+    TrajectoryAxis() : range_min(-1.0), range_max(1.0) { Reset(); }
+
+    void Reset();
+
+    // Targets and setpoints are kept within this
+    void SetRange(double min, double max);
+
+    // The first target of an axis is jumped to, there's no telling where it was before
+    void SetTarget(double new_target);
+
+    // Returns true if the setpoint moved. Never passes the target: every
+    // substep takes the hardest jerk from which a full jerk-limited stop
+    // still ends on it.
+    bool Step(double dt, const MotionLimits& limits);
+    void Finish();
+
+    // Ends the move where the setpoint is now
+    void Halt();
+
+    bool IsMoving() const { return moving; }
+    double GetPosition() const { return position; }
+
+private:
+    double position;
+    double velocity;
+    double acceleration;
+    double target;
+    double range_min;
+    double range_max;
+    bool initialized;
+    bool moving;
+};
+
+class TrajectoryPlanner
+{
+public:
+    TrajectoryPlanner();
+
+    // Whether commands of this type are planned or sent as they are
+    static bool Plans(PTZCommandType type);
+
+    void SetTarget(const PTZCommand& command);
+
+    // True while setpoints are still to be sent
+    bool IsMoving() const;
+
+    // Advances every move by dt seconds and writes a setpoint command for
+    // each that moved. out needs room for NumPTZCommandTypes, returns the count.
+    int Step(double dt, const MotionLimits limits[NumPlannedAxes], PTZCommand* out);
+
+    // Ends every move at its target, writing the final setpoints like Step
+    int Finish(PTZCommand* out);
+
+    // For the axes of commands whose target was submitted before sequence:
+    // Halt ends their moves where they are, without a setpoint. Forget also
+    // drops where they are, so their next target is jumped to, for when the
+    // head was moved behind the planner's back.
+    void Halt(uint32_t commands, uint64_t sequence = UINT64_MAX);
+    void Forget(uint32_t commands, uint64_t sequence = UINT64_MAX);
+
+private:
+    int Collect(const bool moved[NumPlannedAxes], PTZCommand* out) const;
+    static bool Covers(uint32_t commands, PlannedAxis axis);
+
+    TrajectoryAxis axes[NumPlannedAxes];
+
+    // Targets set since the last step, sent then even if nothing had to move
+    bool pending[NumPlannedAxes] = {};
+    // Sequence of each axis' target command, carried on by its setpoints
+    uint64_t target_sequence[NumPlannedAxes] = {};
+};
@@ -0,0 +1,233 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Commands drained from the sender's lanes in the same tick settle in the
+*	order they were submitted, not the order the lanes are drained in.
+*/
+
+#include "NDI_CommandLanes.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static PTZCommand Stamped(PTZCommandType type, uint64_t sequence, float a = 0.f, float b = 0.f) {
+	PTZCommand command = MakeCommand(type, a, b);
+	command.sequence = sequence;
+	return command;
+}
+
+static const MotionLimits limits[NumPlannedAxes] = {
+	{ 1.0, 2.0, 8.0 }, { 1.0, 2.0, 8.0 }, { 1.0, 2.0, 8.0 }, { 1.0, 2.0, 8.0 },
+};
+
+// One tick of the sender's draining, counting what became of the commands
+struct Drained {
+	int count[(int)Intake::Conflated + 1];
+	bool holding;
+	std::chrono::steady_clock::time_point held_until;
+};
+
+static Drained Drain(CommandLanes& lanes, CommandMailbox& mailbox, TrajectoryPlanner& planner, bool plan = true,
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::time_point()) {
+	Drained drained = {};
+	drained.holding = lanes.Drain(now, drained.held_until, [&](const PTZCommand& command) {
+		drained.count[(int)TakeIn(command, plan, mailbox, planner)]++;
+	});
+	return drained;
+}
+
+static void TestStopThenMove() {
+	// The stop skips ahead through the priority lane, which is drained last
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	lanes.Push(Stamped(PTZCommandType::PanTiltSpeed, 1));
+	lanes.PushControl(Stamped(PTZCommandType::PanTiltSpeed, 2, 0.5f, 0.f));
+	Check(Drain(lanes, mailbox, planner).count[(int)Intake::Stale] == 1, "stop then move: stop not found stale");
+
+	PTZCommand command;
+	Check(mailbox.Take(command) && command.a == 0.5f, "stop then move: move lost");
+	Check(mailbox.Empty(), "stop then move: stale stop still pending");
+
+	// Replayed the way a keepalive would, the move stands
+	mailbox.Replay();
+	Check(mailbox.Take(command) && command.a == 0.5f, "stop then move: stop replayed");
+}
+
+static void TestMoveThenStop() {
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	lanes.PushControl(Stamped(PTZCommandType::PanTiltSpeed, 1, 0.5f, 0.f));
+	lanes.Push(Stamped(PTZCommandType::PanTiltSpeed, 2));
+	Drain(lanes, mailbox, planner);
+
+	PTZCommand command;
+	Check(mailbox.Take(command) && command.a == 0.f && command.sequence == 2, "move then stop: stop lost");
+	Check(mailbox.Empty(), "move then stop: move still pending");
+}
+
+static void TestStale() {
+	CommandMailbox mailbox;
+	Check(mailbox.Supersede(Stamped(PTZCommandType::Zoom, 3, 0.5f)), "newer refused");
+	Check(!mailbox.Supersede(Stamped(PTZCommandType::Zoom, 2, 0.2f)), "older taken");
+	Check(mailbox.Supersede(Stamped(PTZCommandType::Zoom, 3, 0.5f)), "same refused");
+	// A stop holds back the older position moves of its axis too
+	Check(mailbox.Supersede(Stamped(PTZCommandType::ZoomSpeed, 5)), "stop refused");
+	Check(!mailbox.Supersede(Stamped(PTZCommandType::Zoom, 4, 0.2f)), "move from before the stop taken");
+	Check(mailbox.Supersede(Stamped(PTZCommandType::Focus, 4, 0.2f)), "other axis held back");
+
+	// Clearing the pending commands doesn't bring the stale ones back
+	mailbox.Clear();
+	Check(!mailbox.Supersede(Stamped(PTZCommandType::Zoom, 4, 0.2f)), "stale after clear");
+}
+
+static void TestPendingMove() {
+	// A stop given before a pending move leaves it be
+	CommandMailbox mailbox;
+	mailbox.Put(Stamped(PTZCommandType::PanTilt, 2, 0.3f, 0.3f));
+	mailbox.Put(Stamped(PTZCommandType::PanTiltSpeed, 1));
+	Check(mailbox.GetPendingCount() == 2, "older stop dropped the move");
+
+	// One given after drops it
+	CommandMailbox later;
+	later.Put(Stamped(PTZCommandType::PanTilt, 1, 0.3f, 0.3f));
+	later.Put(Stamped(PTZCommandType::PanTiltSpeed, 2));
+	PTZCommand command;
+	Check(later.Take(command) && command.type == PTZCommandType::PanTiltSpeed, "newer stop lost");
+	Check(later.Empty(), "newer stop kept the move");
+}
+
+static void TestResendsLast() {
+	// A kept-alive speed waits for every fresh command, exposure included
+	CommandMailbox mailbox;
+	PTZCommand keepalive = Stamped(PTZCommandType::PanTiltSpeed, 1, 0.5f, 0.f);
+	keepalive.resend = true;
+	mailbox.Put(keepalive);
+	mailbox.Put(Stamped(PTZCommandType::ExposureManual, 2, 0.5f, 0.5f));
+	PTZCommand command;
+	Check(mailbox.Take(command) && command.type == PTZCommandType::ExposureManual, "resend went before a fresh command");
+	Check(mailbox.Take(command) && command.resend, "resend lost");
+}
+
+static void TestPlannedMove() {
+	PTZCommand setpoints[NumPTZCommandTypes];
+
+	// The move was given after the stop, it carries on
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	lanes.Push(Stamped(PTZCommandType::Zoom, 1, 0.f));
+	Check(Drain(lanes, mailbox, planner).count[(int)Intake::Started] == 1, "move from rest not started");
+	planner.Step(0.02, limits, setpoints);
+	lanes.PushControl(Stamped(PTZCommandType::Zoom, 3, 1.f));
+	lanes.Push(Stamped(PTZCommandType::ZoomSpeed, 2));
+	Drain(lanes, mailbox, planner);
+	Check(planner.IsMoving(), "older stop halted the move");
+	const int count = planner.Step(0.02, limits, setpoints);
+	Check(count == 1 && setpoints[0].sequence == 3 && mailbox.Put(setpoints[0]) == false, "setpoint refused");
+
+	// The stop was given after the move, it ends it
+	CommandMailbox stopped_mailbox;
+	TrajectoryPlanner stopped;
+	lanes.Push(Stamped(PTZCommandType::Zoom, 1, 0.f));
+	Drain(lanes, stopped_mailbox, stopped);
+	stopped.Step(0.02, limits, setpoints);
+	lanes.PushControl(Stamped(PTZCommandType::Zoom, 2, 1.f));
+	lanes.Push(Stamped(PTZCommandType::ZoomSpeed, 3));
+	Drain(lanes, stopped_mailbox, stopped);
+	Check(!stopped.IsMoving(), "newer stop didn't halt the move");
+}
+
+static void TestRecall() {
+	PTZCommand setpoints[NumPTZCommandTypes];
+
+	// A recall drops where the planner thought the head was, the next
+	// target is jumped to rather than moved to from there
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	lanes.Push(Stamped(PTZCommandType::Zoom, 1, 0.f));
+	Drain(lanes, mailbox, planner);
+	planner.Step(0.02, limits, setpoints);
+	lanes.Push(Stamped(PTZCommandType::Zoom, 2, 1.f));
+	Drain(lanes, mailbox, planner);
+	lanes.Push(Stamped(PTZCommandType::RecallPreset, 3, 3.f, 1.f));
+	Drain(lanes, mailbox, planner);
+	Check(!planner.IsMoving(), "recall: planned move carried on");
+	PTZCommand command;
+	Check(mailbox.Take(command) && command.type == PTZCommandType::RecallPreset, "recall: not pending");
+	lanes.Push(Stamped(PTZCommandType::Zoom, 4, 1.f));
+	Drain(lanes, mailbox, planner);
+	Check(planner.Step(0.02, limits, setpoints) == 1 && setpoints[0].a == 1.f, "recall: next target not jumped to");
+
+	// A move given after the recall, drained before it, carries on
+	CommandMailbox later_mailbox;
+	TrajectoryPlanner later;
+	lanes.Push(Stamped(PTZCommandType::Zoom, 1, 0.f));
+	Drain(lanes, later_mailbox, later);
+	later.Step(0.02, limits, setpoints);
+	lanes.Push(Stamped(PTZCommandType::RecallPreset, 2, 3.f, 1.f));
+	lanes.PushControl(Stamped(PTZCommandType::Zoom, 3, 1.f));
+	Drain(lanes, later_mailbox, later);
+	Check(later.IsMoving(), "recall: newer move dropped");
+	Check(later.Step(0.02, limits, setpoints) == 1 && setpoints[0].a < 1.f, "recall: newer move jumped");
+}
+
+static void TestUnplanned() {
+	// With planning off, absolute moves go straight to the mailbox
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	lanes.Push(Stamped(PTZCommandType::Zoom, 1, 0.3f));
+	lanes.Push(Stamped(PTZCommandType::Zoom, 2, 0.5f));
+	const Drained drained = Drain(lanes, mailbox, planner, false);
+	Check(drained.count[(int)Intake::Pending] == 1 && drained.count[(int)Intake::Conflated] == 1, "unplanned: not conflated");
+	Check(!planner.IsMoving(), "unplanned: planned anyway");
+	PTZCommand command;
+	Check(mailbox.Take(command) && command.a == 0.5f, "unplanned: newest move lost");
+}
+
+static void TestHeld() {
+	// Commands due later stay queued, and so does everything behind them
+	const std::chrono::steady_clock::time_point now;
+	const std::chrono::steady_clock::time_point due = now + std::chrono::milliseconds(10);
+	CommandLanes lanes;
+	CommandMailbox mailbox;
+	TrajectoryPlanner planner;
+	PTZCommand held = Stamped(PTZCommandType::Zoom, 1, 0.5f);
+	held.due = due;
+	lanes.Push(held);
+	lanes.Push(Stamped(PTZCommandType::Zoom, 2, 0.7f));
+	Drained drained = Drain(lanes, mailbox, planner, false, now);
+	Check(drained.holding && drained.held_until == due && mailbox.Empty(), "held: taken early");
+	drained = Drain(lanes, mailbox, planner, false, due);
+	PTZCommand command;
+	Check(!drained.holding && mailbox.Take(command) && command.a == 0.7f, "held: not taken when due");
+}
+
+int main() {
+	TestStopThenMove();
+	TestMoveThenStop();
+	TestStale();
+	TestPendingMove();
+	TestResendsLast();
+	TestPlannedMove();
+	TestRecall();
+	TestUnplanned();
+	TestHeld();
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("command queue: ok\n");
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+* // NDI PTZ Camera controller \\
+*	The adaptive rate climbs while the camera keeps up, and backs off on
+*	latency that stays grown or commands that keep going unanswered, not on
+*	a single straggler.
+*/
+
+#include "NDI_RateAdapter.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what, double value) {
+	if (!ok) {
+		printf("FAIL %s: %g\n", what, value);
+		failures++;
+	}
+}
+
+static const double ceiling = 100.0;
+
+// A camera that answered this many commands in 30 ms, one every 20 ms
+static RateAdapter Warmed(int answers, std::chrono::steady_clock::time_point& now) {
+	RateAdapter adapter;
+	adapter.GetRate(ceiling);
+	for (int i = 0; i < answers; i++) {
+		now += std::chrono::milliseconds(20);
+		adapter.Answered(0.030, now);
+	}
+	return adapter;
+}
+
+static void TestClimbs() {
+	std::chrono::steady_clock::time_point now;
+	RateAdapter adapter = Warmed(20, now);
+	const double rate = adapter.GetRate(ceiling);
+	Check(rate > 20.0, "steady latency didn't climb", rate);
+	Check(adapter.GetLatency() > 0.029 && adapter.GetLatency() < 0.031, "latency off", adapter.GetLatency());
+}
+
+static void TestStraggler() {
+	std::chrono::steady_clock::time_point now;
+	RateAdapter adapter = Warmed(20, now);
+	const double before = adapter.GetRate(ceiling);
+
+	// One slow answer among steady ones
+	now += std::chrono::milliseconds(20);
+	adapter.Answered(0.200, now);
+	const double after = adapter.GetRate(ceiling);
+	Check(after >= before, "backed off on one slow answer", after);
+
+	// Latency that stays grown
+	for (int i = 0; i < 3; i++) {
+		now += std::chrono::milliseconds(20);
+		adapter.Answered(0.200, now);
+	}
+	const double slowed = adapter.GetRate(ceiling);
+	Check(slowed < before, "didn't back off on grown latency", slowed);
+}
+
+static void TestUnanswered() {
+	std::chrono::steady_clock::time_point now;
+	RateAdapter adapter = Warmed(20, now);
+	const double before = adapter.GetRate(ceiling);
+
+	// Missed now and then
+	for (int i = 0; i < 5; i++) {
+		adapter.Unanswered();
+		now += std::chrono::milliseconds(20);
+		adapter.Answered(0.030, now);
+	}
+	const double after = adapter.GetRate(ceiling);
+	Check(after >= before, "backed off on the odd unanswered command", after);
+
+	// Missed in a row
+	adapter.Unanswered();
+	adapter.Unanswered();
+	Check(adapter.GetRate(ceiling) == after, "backed off before the limit", adapter.GetRate(ceiling));
+	adapter.Unanswered();
+	Check(adapter.GetRate(ceiling) == after * 0.5, "didn't back off on unanswered commands", adapter.GetRate(ceiling));
+}
+
+static void TestSilent() {
+	// A camera that never reports its position stays at the starting rate
+	RateAdapter adapter;
+	const double before = adapter.GetRate(ceiling);
+	for (int i = 0; i < 10; i++) {
+		adapter.Unanswered();
+	}
+	Check(adapter.GetRate(ceiling) == before, "silent camera moved off the starting rate", adapter.GetRate(ceiling));
+	Check(before < ceiling, "started at the ceiling", before);
+}
+
+int main() {
+	TestClimbs();
+	TestStraggler();
+	TestUnanswered();
+	TestSilent();
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("rate adapter: ok\n");
+	return 0;
+}
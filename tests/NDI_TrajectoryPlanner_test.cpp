@@ -0,0 +1,77 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Smooth moves never overshoot their target or leave the axis, over a
+*	grid of limits, distances and control rates.
+*/
+
+#include "NDI_TrajectoryPlanner.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what, const MotionLimits& limits, double rate, double from, double to, double value) {
+	if (!ok) {
+		printf("FAIL %s: v %g a %g j %g at %g Hz, %g -> %g: %g\n",
+			what, limits.velocity, limits.acceleration, limits.jerk, rate, from, to, value);
+		failures++;
+	}
+}
+
+static void TestMove(const MotionLimits& limits, double rate, double from, double to) {
+	TrajectoryAxis axis;
+	axis.SetRange(-1.0, 1.0);
+	axis.SetTarget(from);
+	axis.SetTarget(to);
+
+	const double direction = to > from ? 1.0 : -1.0;
+	// Slowest possible move: the whole distance at the velocity limit, plus ramps
+	const double timeout = std::fabs(to - from) / limits.velocity + 4.0 * (limits.velocity / limits.acceleration + limits.acceleration / limits.jerk) + 1.0;
+	double overshoot = 0.0;
+	double lowest = from;
+	double highest = from;
+	double t = 0.0;
+	while (axis.IsMoving() && t < timeout) {
+		axis.Step(1.0 / rate, limits);
+		t += 1.0 / rate;
+		const double position = axis.GetPosition();
+		overshoot = std::max(overshoot, (position - to) * direction);
+		lowest = std::min(lowest, position);
+		highest = std::max(highest, position);
+	}
+
+	Check(overshoot <= 1e-9, "overshoot", limits, rate, from, to, overshoot);
+	Check(lowest >= -1.0 && highest <= 1.0, "left range", limits, rate, from, to, std::max(-lowest, highest));
+	Check(!axis.IsMoving(), "never settled", limits, rate, from, to, axis.GetPosition());
+	Check(axis.GetPosition() == to, "missed target", limits, rate, from, to, axis.GetPosition());
+}
+
+int main() {
+	const double velocities[] = { 0.2, 1.0, 2.0, 4.0 };
+	const double accelerations[] = { 0.5, 2.0, 8.0 };
+	const double jerks[] = { 2.0, 8.0, 32.0, 200.0 };
+	const double rates[] = { 10.0, 50.0, 200.0 };
+	const double moves[][2] = { { -1.0, 1.0 }, { 1.0, -1.0 }, { 0.3, 0.31 }, { 0.9, -0.95 }, { 0.0, 0.5 } };
+
+	for (double velocity : velocities) {
+		for (double acceleration : accelerations) {
+			for (double jerk : jerks) {
+				for (double rate : rates) {
+					for (const double* move : moves) {
+						const MotionLimits limits = { velocity, acceleration, jerk };
+						TestMove(limits, rate, move[0], move[1]);
+					}
+				}
+			}
+		}
+	}
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("trajectory: ok\n");
+	return 0;
+}
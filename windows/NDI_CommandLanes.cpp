@@ -0,0 +1,48 @@
+/*
+* // NDI PTZ Camera controller \\
+*	The lanes commands reach the sender through, and how what the sender
+*	drains from them settles into its mailbox and trajectory planner.
+*/
+
+#include "NDI_CommandLanes.h"
+
+Intake TakeIn(const PTZCommand& command, bool plan, CommandMailbox& mailbox, TrajectoryPlanner& planner) {
+	// The lanes are drained one after the other, so a command can arrive
+	// after a newer one for its axis. That one stands.
+	if (!mailbox.Supersede(command)) {
+		return Intake::Stale;
+	}
+
+	// A stop ends the planned move of its axis where it is, unless the move
+	// was given after it. A recall moves the head somewhere the planner can't
+	// know, so it starts over from the next target.
+	const uint32_t preempted = GetPreempted(command);
+	if (preempted != 0) {
+		if (command.type == PTZCommandType::RecallPreset) {
+			planner.Forget(preempted, command.sequence);
+		}
+		else {
+			planner.Halt(preempted, command.sequence);
+		}
+	}
+
+	if (plan && TrajectoryPlanner::Plans(command.type)) {
+		const bool started = !planner.IsMoving();
+		planner.SetTarget(command);
+		return started ? Intake::Started : Intake::Planned;
+	}
+
+	return mailbox.Put(command) ? Intake::Conflated : Intake::Pending;
+}
+
+bool CommandLanes::Push(const PTZCommand& command) {
+	const bool urgent = command.due == std::chrono::steady_clock::time_point() && GetPriority(command) <= PTZPriority::Preset;
+	return urgent ? priority_lane.TryPush(command) : queued_lane.TryPush(command);
+}
+
+void CommandLanes::Clear() {
+	PTZCommand command;
+	while (queued_lane.TryPop(command)) {}
+	while (control_lane.TryPop(command)) {}
+	while (priority_lane.TryPop(command)) {}
+}
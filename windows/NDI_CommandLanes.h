@@ -0,0 +1,80 @@
+/*
+* // NDI PTZ Camera controller \\
+*	The lanes commands reach the sender through, and how what the sender
+*	drains from them settles into its mailbox and trajectory planner.
+*/
+
+#pragma once
+
+#include "NDI_CommandQueue.h"
+#include "NDI_TrajectoryPlanner.h"
+
+#include <stdint.h>
+#include <chrono>
+
+// What became of a command taken in
+enum class Intake : uint8_t {
+	Stale,		// a newer command for its axis was taken in already
+	Started,	// planned, setting the planner in motion
+	Planned,	// planned, joining a move under way
+	Pending,	// waits in the mailbox
+	Conflated,	// replaced a command pending in the mailbox
+};
+
+// Takes a drained command in. It stops the planned moves it pre-empts, unless
+// they were given after it, then goes to the planner while plan is set and
+// the planner plans its type, to the mailbox otherwise.
+Intake TakeIn(const PTZCommand& command, bool plan, CommandMailbox& mailbox, TrajectoryPlanner& planner);
+
+class CommandLanes
+{
+public:
+	// Cook thread. Stops and preset recalls due right away take the priority
+	// lane past commands held back, the rest queue in order of their due times.
+	// Returns false if the lane is full.
+	bool Push(const PTZCommand& command);
+
+	// Control loop thread. Its commands are always current.
+	bool PushControl(const PTZCommand& command) { return control_lane.TryPush(command); }
+
+	// Sender thread. Hands take every command due by now: the queued lane
+	// first, then the control lane, then the priority lane, so stops and
+	// recalls pre-empt the moves drained with them. Returns true if the queued
+	// lane holds commands for later, held_until being when the first is due.
+	template <typename Take>
+	bool Drain(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& held_until, Take take) {
+		PTZCommand command;
+		bool holding = false;
+		while (queued_lane.TryPeek(command)) {
+			if (command.due > now) {
+				holding = true;
+				held_until = command.due;
+				break;
+			}
+			queued_lane.TryPop(command);
+			take(command);
+		}
+		while (control_lane.TryPop(command)) {
+			take(command);
+		}
+		while (priority_lane.TryPop(command)) {
+			take(command);
+		}
+		return holding;
+	}
+
+	// Sender thread. Drops everything waiting in the lanes.
+	void Clear();
+
+	size_t SizeApprox() const {
+		return queued_lane.SizeApprox() + control_lane.SizeApprox() + priority_lane.SizeApprox();
+	}
+
+	// Something is waiting that skips the line
+	bool IsPriorityWaiting() const { return priority_lane.SizeApprox() != 0; }
+
+private:
+	SpscQueue<PTZCommand, 256> queued_lane;
+	SpscQueue<PTZCommand, 64> control_lane;
+	SpscQueue<PTZCommand, 16> priority_lane;
+};
@@ -0,0 +1,461 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Sender thread that makes the blocking NDIlib_recv_ptz_* calls
+*	on behalf of the cook thread.
+*/
+
+#include "NDI_CommandSender.h"
+#include "NDI_Realtime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static std::atomic<uint32_t> next_client_id(0);
+
+// A move to within this of the reported position won't show the axis moving
+static const double reported_tolerance = 0.001;
+
+static bool AtReported(float target, double reported) {
+	return std::fabs(target - reported) <= reported_tolerance;
+}
+
+// Axes the camera reports moving once it acts on the command. Stops are
+// left out, as the head was moving anyway, and so is exposure. So are resends
+// and moves to where the camera last reported being, which it may not act on.
+static uint32_t GetMovedAxes(const PTZCommand& command, const CameraPosition& position) {
+	if (command.resend || GetPriority(command) == PTZPriority::Stop) {
+		return 0;
+	}
+	switch (command.type) {
+	case PTZCommandType::PanTilt: return AtReported(command.a, position.pan) && AtReported(command.b, position.tilt) ? 0u : PositionPan | PositionTilt;
+	case PTZCommandType::PanTiltSpeed: return PositionPan | PositionTilt;
+	case PTZCommandType::Zoom: return AtReported(command.a, position.zoom) ? 0u : (uint32_t)PositionZoom;
+	case PTZCommandType::ZoomSpeed: return PositionZoom;
+	case PTZCommandType::Focus: return AtReported(command.a, position.focus) ? 0u : (uint32_t)PositionFocus;
+	case PTZCommandType::FocusSpeed: return PositionFocus;
+	case PTZCommandType::RecallPreset: return PositionPan | PositionTilt | PositionZoom | PositionFocus;
+	default: return 0;
+	}
+}
+
+CommandSender::CommandSender() : mailbox_depth(0), batching(false), command_rate(10.0), command_burst(1.0), adaptive_rate(false), control_rate(50.0), speeds(), speeds_set(0), deadman_stopped(0), client_id(++next_client_id), running(false), replay_requested(false), stop_requested(false),
+	next_sequence(1), submitted_count(0), sent_count(0), conflated_count(0), dropped_count(0), blocked_count(0), throttled_count(0), frame_count(0), deadman_count(0)
+{
+	for (std::atomic<std::chrono::steady_clock::rep>& fed : fed_at) {
+		fed.store(0, std::memory_order_relaxed);
+	}
+	for (std::atomic<uint64_t>& sent : sent_by_type) {
+		sent.store(0, std::memory_order_relaxed);
+	}
+}
+
+CommandSender::~CommandSender()
+{
+	Stop();
+}
+
+void CommandSender::Start() {
+	if (running.exchange(true)) {
+		return;
+	}
+	worker = std::thread(&CommandSender::Run, this);
+}
+
+void CommandSender::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		running.store(false);
+	}
+	wake.notify_one();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void CommandSender::SetReceiver(const std::shared_ptr<SharedReceiver>& recv) {
+	std::lock_guard<std::mutex> lock(receiver_mutex);
+	receiver = recv;
+}
+
+void CommandSender::SetCommandRate(double rate, double burst, bool adaptive) {
+	command_rate.store(rate > 0.0 ? rate : 0.0, std::memory_order_relaxed);
+	command_burst.store(std::max(burst, 1.0), std::memory_order_relaxed);
+	adaptive_rate.store(adaptive, std::memory_order_relaxed);
+}
+
+double CommandSender::GetPacedRate() {
+	std::lock_guard<std::mutex> lock(receiver_mutex);
+	return receiver ? receiver->GetPacedRate() : 0.0;
+}
+
+double CommandSender::GetCommandLatency() {
+	std::lock_guard<std::mutex> lock(receiver_mutex);
+	return receiver ? receiver->GetCommandLatency() : 0.0;
+}
+
+LatencySummary CommandSender::GetFeedbackLatency() {
+	std::lock_guard<std::mutex> lock(receiver_mutex);
+	if (!receiver) {
+		const LatencySummary none = { 0, -1.0, -1.0, -1.0, -1.0 };
+		return none;
+	}
+	return receiver->GetLatencySummary();
+}
+
+void CommandSender::ResetFeedbackLatency() {
+	std::lock_guard<std::mutex> lock(receiver_mutex);
+	if (receiver) {
+		receiver->ResetLatency();
+	}
+}
+
+bool CommandSender::Submit(const PTZCommand& command, std::chrono::steady_clock::time_point due) {
+	PTZCommand timed = command;
+	timed.due = due;
+	timed.sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+	if (!lanes.Push(timed)) {
+		dropped_count.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	submitted_count.fetch_add(1, std::memory_order_relaxed);
+
+	// Taking the lock only orders us against the sender going to sleep,
+	// it is never held while a command is being sent.
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+	}
+	wake.notify_one();
+	return true;
+}
+
+bool CommandSender::SubmitControl(const PTZCommand& command) {
+	PTZCommand stamped = command;
+	stamped.sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+	if (!lanes.PushControl(stamped)) {
+		dropped_count.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	submitted_count.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+	}
+	wake.notify_one();
+	return true;
+}
+
+void CommandSender::SetTrajectory(const TrajectorySettings& settings) {
+	trajectory.Store(settings);
+}
+
+void CommandSender::SetControlRate(double rate) {
+	control_rate.store(std::max(rate, 1.0), std::memory_order_relaxed);
+}
+
+void CommandSender::SetKeepalive(const KeepaliveSettings& settings) {
+	keepalive.Store(settings);
+}
+
+void CommandSender::Feed(uint32_t commands) {
+	const std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+	for (int i = 0; i < NumPTZCommandTypes; i++) {
+		if (commands & (1u << i)) {
+			fed_at[i].store(now, std::memory_order_relaxed);
+		}
+	}
+}
+
+void CommandSender::SetBatching(bool enabled) {
+	batching.store(enabled, std::memory_order_relaxed);
+}
+
+void CommandSender::RequestReplay() {
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		replay_requested.store(true);
+	}
+	wake.notify_one();
+}
+
+void CommandSender::EmergencyStop() {
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		stop_requested.store(true);
+	}
+	wake.notify_one();
+}
+
+void CommandSender::Run() {
+	// Sends and planned moves keep their pace while TouchDesigner is busy
+	RealtimeThreadScope realtime(ThreadPriority::Sender);
+
+	PTZCommand setpoints[NumPTZCommandTypes];
+	std::chrono::steady_clock::time_point next_send = std::chrono::steady_clock::now();
+
+	while (running.load()) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const TrajectorySettings smoothing = trajectory.Load();
+		const KeepaliveSettings keepalive_now = keepalive.Load();
+
+		if (stop_requested.exchange(false)) {
+			Halt();
+		}
+
+		// Draining is cheap, so always pull everything that is due. Whatever
+		// the camera hasn't been sent yet is replaced by the newer value.
+		// Commands resampled from an input CHOP are spread over the timeslice
+		// they came from, those stay queued until their time.
+		std::chrono::steady_clock::time_point held_until;
+		const bool holding = lanes.Drain(now, held_until, [&](const PTZCommand& command) {
+			Enqueue(command, smoothing.enabled, now);
+		});
+
+		if (planner.IsMoving()) {
+			int count = 0;
+			if (!smoothing.enabled) {
+				// Switched off mid-move: straight to the targets
+				count = planner.Finish(setpoints);
+			}
+			else if (now >= next_step) {
+				// Moves advance at the control rate, their setpoints are
+				// conflated down to the command rate like any other command
+				const double dt = std::chrono::duration<double>(now - last_step).count();
+				count = planner.Step(std::min(dt, 0.25), smoothing.limits, setpoints);
+				last_step = now;
+				AdvanceTick(next_step, GetTickPeriod(control_rate.load(std::memory_order_relaxed)), now);
+			}
+			for (int i = 0; i < count; i++) {
+				mailbox.Put(setpoints[i]);
+			}
+		}
+
+		// The camera came back and may have lost what it was last told
+		if (replay_requested.exchange(false)) {
+			mailbox.Replay();
+		}
+
+		if (keepalive_now.enabled && now >= next_keepalive) {
+			KeepAlive(keepalive_now, now);
+			AdvanceTick(next_keepalive, GetTickPeriod(keepalive_now.rate), now);
+		}
+
+		if (!mailbox.Empty() && now >= next_send) {
+			std::shared_ptr<SharedReceiver> shared_recv;
+			{
+				std::lock_guard<std::mutex> lock(receiver_mutex);
+				shared_recv = receiver;
+			}
+
+			const std::chrono::steady_clock::duration wait = shared_recv ?
+				shared_recv->TakeToken(command_rate.load(std::memory_order_relaxed), command_burst.load(std::memory_order_relaxed),
+					adaptive_rate.load(std::memory_order_relaxed)) :
+				std::chrono::steady_clock::duration::zero();
+			if (wait == std::chrono::steady_clock::duration::zero()) {
+				// Axes still take turns: the one whose turn it is brings every
+				// other pending axis that fits in the same frame along
+				PTZCommand batch[NumPTZCommandTypes];
+				mailbox.Take(batch[0]);
+				int count = 1;
+				if (batching.load(std::memory_order_relaxed) && PTZXmlWriter::Writes(batch[0].type)) {
+					count += mailbox.TakeAll(PTZXmlWriter::Batched, batch + 1);
+				}
+				const std::chrono::steady_clock::time_point sent_at = std::chrono::steady_clock::now();
+				if (DispatchBatch(batch, count, shared_recv)) {
+					CountSent(batch, count);
+					frame_count.fetch_add(1, std::memory_order_relaxed);
+
+					const CameraPosition position = shared_recv->GetPosition();
+					uint32_t axes = 0;
+					for (int i = 0; i < count; i++) {
+						axes |= GetMovedAxes(batch[i], position);
+					}
+					shared_recv->CommandSent(sent_at, axes);
+				}
+				continue;
+			}
+
+			// The camera's bucket is empty. Nothing queues up behind it:
+			// newer values keep replacing the pending ones until a token is back.
+			throttled_count.fetch_add(1, std::memory_order_relaxed);
+			next_send = now + wait;
+		}
+
+		mailbox_depth.store(mailbox.GetPendingCount(), std::memory_order_relaxed);
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+		if (mailbox.Empty() && !holding && !planner.IsMoving() && !keepalive_now.enabled) {
+			wake.wait_for(lock, std::chrono::milliseconds(100), [this] {
+				return !running.load() || replay_requested.load() || stop_requested.load() ||
+					lanes.SizeApprox() != 0;
+			});
+		}
+		else {
+			// Something is pending but the camera isn't ready for it yet, or the
+			// next command isn't due. New commands either replace what's pending
+			// or queue up behind the held one, so there's no need to wake for them,
+			// unless they skip the line.
+			std::chrono::steady_clock::time_point wake_at = std::chrono::steady_clock::time_point::max();
+			if (!mailbox.Empty()) {
+				wake_at = next_send;
+			}
+			if (holding && held_until < wake_at) {
+				wake_at = held_until;
+			}
+			if (planner.IsMoving() && next_step < wake_at) {
+				wake_at = next_step;
+			}
+			if (keepalive_now.enabled && next_keepalive < wake_at) {
+				wake_at = next_keepalive;
+			}
+			wake.wait_until(lock, wake_at, [this] {
+				return !running.load() || replay_requested.load() || stop_requested.load() || lanes.IsPriorityWaiting();
+			});
+		}
+	}
+}
+
+void CommandSender::Enqueue(const PTZCommand& command, bool plan, std::chrono::steady_clock::time_point now) {
+	const Intake intake = TakeIn(command, plan, mailbox, planner);
+	if (intake == Intake::Stale || intake == Intake::Conflated) {
+		conflated_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (intake == Intake::Stale) {
+		return;
+	}
+
+	if (SpeedCommands & (1u << (int)command.type)) {
+		speeds[(int)command.type] = command;
+		speeds_set |= 1u << (int)command.type;
+	}
+
+	// A move from rest starts its clock now
+	if (intake == Intake::Started) {
+		last_step = next_step = now;
+	}
+}
+
+bool CommandSender::Dispatch(const PTZCommand& command, const std::shared_ptr<SharedReceiver>& shared_recv) {
+	if (!shared_recv) {
+		return false;
+	}
+
+	// Other instances on the same camera get a turn once this one goes quiet
+	if (!shared_recv->ClaimControl(client_id)) {
+		blocked_count.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	NDIlib_recv_instance_t recv = shared_recv->GetHandle();
+
+	switch (command.type) {
+	case PTZCommandType::PanTilt: { NDIlib_recv_ptz_pan_tilt(recv, command.a, command.b); break; }
+	case PTZCommandType::PanTiltSpeed: { NDIlib_recv_ptz_pan_tilt_speed(recv, command.a, command.b); break; }
+	case PTZCommandType::Zoom: { NDIlib_recv_ptz_zoom(recv, command.a); break; }
+	case PTZCommandType::ZoomSpeed: { NDIlib_recv_ptz_zoom_speed(recv, command.a); break; }
+	case PTZCommandType::Focus: { NDIlib_recv_ptz_focus(recv, command.a); break; }
+	case PTZCommandType::FocusSpeed: { NDIlib_recv_ptz_focus_speed(recv, command.a); break; }
+	case PTZCommandType::ExposureManual: { NDIlib_recv_ptz_exposure_manual_v2(recv, command.a, command.b, command.c); break; }
+	case PTZCommandType::RecallPreset: { NDIlib_recv_ptz_recall_preset(recv, (int)command.a, command.b); break; }
+	}
+	return true;
+}
+
+void CommandSender::KeepAlive(const KeepaliveSettings& settings, std::chrono::steady_clock::time_point now) {
+	const std::chrono::steady_clock::duration timeout =
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(settings.timeout));
+
+	for (int i = 0; i < NumPTZCommandTypes; i++) {
+		if (!(speeds_set & SpeedCommands & (1u << i))) {
+			continue;
+		}
+
+		// Fresh axes get their speed again, in case the camera missed it.
+		// Not a stopped one, nor over a command still waiting to go out.
+		const std::chrono::steady_clock::time_point fed(std::chrono::steady_clock::duration(fed_at[i].load(std::memory_order_relaxed)));
+		if (now - fed <= timeout) {
+			if (GetPriority(speeds[i]) != PTZPriority::Stop && !mailbox.IsPending(speeds[i].type)) {
+				PTZCommand keepalive = speeds[i];
+				keepalive.resend = true;
+				mailbox.Put(keepalive);
+			}
+			deadman_stopped &= ~(1u << i);
+			continue;
+		}
+
+		// The cook went quiet: stop the axis, once. Its speed goes out
+		// again with the first keepalive after the cook is back.
+		if (!(deadman_stopped & (1u << i)) && GetPriority(speeds[i]) != PTZPriority::Stop) {
+			// Stands in for the speed it stops, so that speed can resume it
+			PTZCommand stop = MakeCommand(speeds[i].type);
+			stop.sequence = speeds[i].sequence;
+			mailbox.Put(stop);
+			deadman_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		deadman_stopped |= 1u << i;
+	}
+}
+
+void CommandSender::Halt() {
+	// Everything in flight was meant for before the stop
+	lanes.Clear();
+	mailbox.Clear();
+	planner.Halt(MotionCommands);
+	// Nor are the speeds kept alive any longer
+	speeds_set = 0;
+
+	std::shared_ptr<SharedReceiver> shared_recv;
+	{
+		std::lock_guard<std::mutex> lock(receiver_mutex);
+		shared_recv = receiver;
+	}
+	if (!shared_recv) {
+		return;
+	}
+
+	NDIlib_recv_instance_t recv = shared_recv->GetHandle();
+	NDIlib_recv_ptz_pan_tilt_speed(recv, 0.f, 0.f);
+	NDIlib_recv_ptz_zoom_speed(recv, 0.f);
+	NDIlib_recv_ptz_focus_speed(recv, 0.f);
+
+	const PTZCommand stops[] = {
+		MakeCommand(PTZCommandType::PanTiltSpeed),
+		MakeCommand(PTZCommandType::ZoomSpeed),
+		MakeCommand(PTZCommandType::FocusSpeed),
+	};
+	CountSent(stops, 3);
+	frame_count.fetch_add(3, std::memory_order_relaxed);
+}
+
+void CommandSender::CountSent(const PTZCommand* commands, int count) {
+	for (int i = 0; i < count; i++) {
+		sent_by_type[(int)commands[i].type].fetch_add(1, std::memory_order_relaxed);
+	}
+	sent_count.fetch_add(count, std::memory_order_relaxed);
+}
+
+bool CommandSender::DispatchBatch(const PTZCommand* commands, int count, const std::shared_ptr<SharedReceiver>& shared_recv) {
+	if (count == 1) {
+		return Dispatch(commands[0], shared_recv);
+	}
+	if (!shared_recv) {
+		return false;
+	}
+
+	if (!shared_recv->ClaimControl(client_id)) {
+		blocked_count.fetch_add(count, std::memory_order_relaxed);
+		return false;
+	}
+
+	xml_writer.Clear();
+	for (int i = 0; i < count; i++) {
+		xml_writer.Append(commands[i]);
+	}
+
+	NDIlib_metadata_frame_t frame;
+	frame.p_data = xml_writer.GetData();
+	frame.length = xml_writer.GetLength() + 1;
+	NDIlib_recv_send_metadata(shared_recv->GetHandle(), &frame);
+	return true;
+}
@@ -0,0 +1,231 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Connection lifecycle of one instance. Connects, health checks and
+*	reconnects all run on a worker thread, the cook thread only asks for a
+*	source and reads back the state.
+*/
+
+#include "NDI_Connection.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+// How often the worker looks at the connection
+static const std::chrono::milliseconds health_interval(100);
+// How long a connection may be silent before the receiver is replaced
+static const std::chrono::milliseconds degraded_grace(2000);
+// Pause after the first failed reconnect, doubled after every further one
+static const std::chrono::milliseconds backoff_min(500);
+static const std::chrono::milliseconds backoff_max(30000);
+
+const char* GetConnectionStateName(ConnectionState state) {
+	switch (state) {
+	case ConnectionState::Idle: return "idle";
+	case ConnectionState::Connecting: return "connecting";
+	case ConnectionState::Connected: return "connected";
+	case ConnectionState::Degraded: return "degraded";
+	case ConnectionState::Reconnecting: return "reconnecting";
+	}
+	return "unknown";
+}
+
+CameraConnection::CameraConnection(CommandSender& sender) : sender(sender), pool(nullptr),
+	backoff(backoff_min), jitter((unsigned)std::chrono::steady_clock::now().time_since_epoch().count()),
+	state((int)ConnectionState::Idle), connect_latency(-1.0), reconnect_count(0), running(false), has_pending(false)
+{
+	current.connect = false;
+	current.receive_video = false;
+}
+
+CameraConnection::~CameraConnection()
+{
+	Stop();
+}
+
+void CameraConnection::Start(ReceiverPool& receivers) {
+	if (running.exchange(true)) {
+		return;
+	}
+	pool = &receivers;
+	worker = std::thread(&CameraConnection::Run, this);
+}
+
+void CameraConnection::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(request_mutex);
+		running.store(false);
+	}
+	wake.notify_one();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	// Our reference has to go before the runtime does
+	SetReceiver(nullptr);
+}
+
+void CameraConnection::Connect(const std::string& url, const std::string& name, bool receive_video) {
+	{
+		std::lock_guard<std::mutex> lock(request_mutex);
+		pending.connect = true;
+		pending.url = url;
+		pending.name = name;
+		pending.receive_video = receive_video;
+		has_pending = true;
+	}
+	wake.notify_one();
+}
+
+void CameraConnection::Disconnect() {
+	{
+		std::lock_guard<std::mutex> lock(request_mutex);
+		pending.connect = false;
+		has_pending = true;
+	}
+	wake.notify_one();
+}
+
+void CameraConnection::Run() {
+	Request request;
+
+	while (running.load()) {
+		bool has_request = false;
+		{
+			std::unique_lock<std::mutex> lock(request_mutex);
+			if (!has_pending) {
+				wake.wait_for(lock, health_interval, [this] { return !running.load() || has_pending; });
+			}
+			if (!running.load()) {
+				break;
+			}
+			// Only the newest request matters, anything older was overwritten
+			if (has_pending) {
+				request = pending;
+				has_pending = false;
+				has_request = true;
+			}
+		}
+
+		if (has_request) {
+			Handle(request);
+		}
+		else {
+			CheckHealth();
+		}
+	}
+}
+
+void CameraConnection::Handle(const Request& request) {
+	// Asked for what we already have, e.g. the same source picked again
+	if (request.connect && current.connect && receiver &&
+		request.url == current.url && request.receive_video == current.receive_video) {
+		return;
+	}
+
+	// Let go of the old camera first, whatever happens next
+	SetReceiver(nullptr);
+	current = request;
+
+	if (!request.connect) {
+		SetState(ConnectionState::Idle);
+		return;
+	}
+
+	printf("Connecting to camera at %s\n", request.url.c_str());
+	connect_start = std::chrono::steady_clock::now();
+	connect_latency.store(-1.0, std::memory_order_relaxed);
+
+	backoff = backoff_min;
+	SetReceiver(pool->Acquire(request.url, request.name, request.receive_video));
+	if (receiver) {
+		SetState(ConnectionState::Connecting);
+	}
+	else {
+		SetState(ConnectionState::Reconnecting);
+		retry_at = connect_start + backoff;
+	}
+}
+
+void CameraConnection::CheckHealth() {
+	const ConnectionState current_state = GetState();
+	if (current_state == ConnectionState::Idle) {
+		return;
+	}
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	const bool answering = receiver && NDIlib_recv_get_no_connections(receiver->GetHandle()) > 0;
+
+	switch (current_state) {
+	case ConnectionState::Connecting:
+	case ConnectionState::Reconnecting:
+		if (answering) {
+			connect_latency.store(std::chrono::duration<double, std::milli>(now - connect_start).count(), std::memory_order_relaxed);
+			backoff = backoff_min;
+			SetState(ConnectionState::Connected);
+
+			// Whatever happened to the camera while we weren't talking to it,
+			// put it back where it was last told to be
+			sender.RequestReplay();
+		}
+		else if (current_state == ConnectionState::Reconnecting && now >= retry_at) {
+			Reconnect(now);
+		}
+		break;
+
+	case ConnectionState::Connected:
+		if (!answering) {
+			degraded_since = now;
+			SetState(ConnectionState::Degraded);
+		}
+		break;
+
+	case ConnectionState::Degraded:
+		if (answering) {
+			SetState(ConnectionState::Connected);
+			sender.RequestReplay();
+		}
+		else if (now - degraded_since >= degraded_grace) {
+			connect_start = now;
+			SetState(ConnectionState::Reconnecting);
+			Reconnect(now);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CameraConnection::Reconnect(std::chrono::steady_clock::time_point now) {
+	SetReceiver(pool->Reconnect(receiver, current.url, current.name, current.receive_video));
+	reconnect_count.fetch_add(1, std::memory_order_relaxed);
+
+	// Jittered so a room full of controllers doesn't hit a rebooting
+	// camera in lockstep: wait somewhere between half and all of the backoff
+	std::uniform_int_distribution<long long> spread(backoff.count() / 2, backoff.count());
+	retry_at = now + std::chrono::milliseconds(spread(jitter));
+	backoff = std::min(backoff * 2, backoff_max);
+}
+
+void CameraConnection::SetReceiver(const std::shared_ptr<SharedReceiver>& recv) {
+	// The sender keeps its own reference while a call is in flight,
+	// so dropping ours here never pulls the handle from under it
+	sender.SetReceiver(recv);
+	receiver = recv;
+
+	std::lock_guard<std::mutex> lock(published_mutex);
+	published = recv;
+}
+
+CameraPosition CameraConnection::GetPosition() {
+	std::lock_guard<std::mutex> lock(published_mutex);
+	return published ? published->GetPosition() : CameraPosition();
+}
+
+void CameraConnection::SetState(ConnectionState new_state) {
+	const int old_state = state.exchange((int)new_state, std::memory_order_relaxed);
+	if (old_state != (int)new_state) {
+		printf("Camera %s: %s\n", current.url.c_str(), GetConnectionStateName(new_state));
+	}
+}
@@ -0,0 +1,101 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Connection lifecycle of one instance. Connects, health checks and
+*	reconnects all run on a worker thread, the cook thread only asks for a
+*	source and reads back the state.
+*/
+
+#pragma once
+
+#include "Processing.NDI.Lib.h"
+#include "NDI_CommandSender.h"
+#include "NDI_ReceiverPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+// Values are output as a channel, so only ever append
+enum class ConnectionState : int {
+	Idle,			// no source selected
+	Connecting,		// receiver created, waiting for the camera to answer
+	Connected,
+	Degraded,		// camera stopped answering, it may still come back by itself
+	Reconnecting,	// gave up on the old receiver and asked for a new one
+};
+
+const char* GetConnectionStateName(ConnectionState state);
+
+class CameraConnection
+{
+public:
+	// Hands every new receiver to this sender
+	explicit CameraConnection(CommandSender& sender);
+	~CameraConnection();
+
+	void Start(ReceiverPool& pool);
+	void Stop();
+
+	// Cook thread. Both return immediately, the work happens on the worker.
+	void Connect(const std::string& url, const std::string& name, bool receive_video);
+	void Disconnect();
+
+	ConnectionState GetState() const { return (ConnectionState)state.load(std::memory_order_relaxed); }
+
+	// Milliseconds from asking for the source until the camera answered, -1 until then
+	double GetConnectLatency() const { return connect_latency.load(std::memory_order_relaxed); }
+
+	// Receivers replaced because the camera stopped answering
+	uint64_t GetReconnectCount() const { return reconnect_count.load(std::memory_order_relaxed); }
+
+	// Where the camera last said it is, all zero while there's no receiver
+	CameraPosition GetPosition();
+
+private:
+	struct Request {
+		bool connect;
+		std::string url;
+		std::string name;
+		bool receive_video;
+	};
+
+	void Run();
+	void Handle(const Request& request);
+	void CheckHealth();
+	void SetReceiver(const std::shared_ptr<SharedReceiver>& recv);
+	void SetState(ConnectionState new_state);
+	void Reconnect(std::chrono::steady_clock::time_point now);
+
+	CommandSender& sender;
+	ReceiverPool* pool;
+
+	// Worker thread only
+	Request current;
+	std::shared_ptr<SharedReceiver> receiver;
+	std::chrono::steady_clock::time_point connect_start;
+	std::chrono::steady_clock::time_point degraded_since;
+	std::chrono::steady_clock::time_point retry_at;
+	std::chrono::milliseconds backoff;
+	std::minstd_rand jitter;
+
+	std::atomic<int> state;
+	std::atomic<double> connect_latency;
+	std::atomic<uint64_t> reconnect_count;
+	std::atomic<bool> running;
+
+	std::thread worker;
+
+	// The worker's receiver, for the cook thread to read feedback from
+	std::mutex published_mutex;
+	std::shared_ptr<SharedReceiver> published;
+
+	std::mutex request_mutex;
+	std::condition_variable wake;
+	Request pending;
+	bool has_pending;
+};
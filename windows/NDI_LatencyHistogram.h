@@ -0,0 +1,48 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Lock-free log-linear latency histogram. Every power of two is split into
+*	16 linear buckets, so any percentile is within about 6% of the real value
+*	from a microsecond up to a minute, in a fixed block of counters.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Milliseconds, all -1 while nothing was recorded
+struct LatencySummary {
+	uint64_t count;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	// Any thread, never waits. Longer than the top bucket counts as the top bucket.
+	void Record(uint64_t microseconds);
+
+	// Any thread. A sample recorded while this runs may survive it.
+	void Reset();
+
+	// Any thread. Counts are read one by one, so only a snapshot.
+	LatencySummary Summarize() const;
+
+private:
+	static const int SubBits = 4;
+	static const int SubBuckets = 1 << SubBits;
+	// Up to 2^26 microseconds, a little over a minute
+	static const int NumBuckets = (26 - SubBits + 1) * SubBuckets;
+
+	static int GetBucket(uint64_t microseconds);
+	// Highest value that lands in the bucket
+	static uint64_t GetBucketTop(int bucket);
+
+	std::atomic<uint64_t> buckets[NumBuckets];
+	std::atomic<uint64_t> max_us;
+};
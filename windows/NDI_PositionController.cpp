@@ -0,0 +1,156 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Closed-loop positioning. Steers pan, tilt and zoom towards their targets
+*	with speed commands, from the position the camera reports back.
+*/
+
+#include "NDI_PositionController.h"
+#include "NDI_Realtime.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Closer than this counts as there, so the head settles instead of hunting
+static const double position_tolerance = 0.002;
+
+// Without a fresh report the loop can't tell where the head is, so it stops it
+static const std::chrono::milliseconds feedback_timeout(500);
+
+void PIDController::Reset() {
+	integral = 0.0;
+	last_position = 0.0;
+	has_last = false;
+}
+
+double PIDController::Update(double target, double position, double dt, const PIDGains& gains) {
+	const double error = target - position;
+	if (std::fabs(error) < position_tolerance) {
+		integral = 0.0;
+		last_position = position;
+		has_last = true;
+		return 0.0;
+	}
+
+	// Derivative on the measurement, so a new target doesn't kick the head
+	const double derivative = has_last ? -(position - last_position) / dt : 0.0;
+	last_position = position;
+	has_last = true;
+
+	// Anti-windup: the integral only grows while the output isn't saturated,
+	// or while the error is pulling it back out of saturation
+	const double candidate = integral + error * dt;
+	double output = gains.kp * error + gains.ki * candidate + gains.kd * derivative;
+	if ((output > 1.0 && error > 0.0) || (output < -1.0 && error < 0.0)) {
+		output = gains.kp * error + gains.ki * integral + gains.kd * derivative;
+	}
+	else {
+		integral = candidate;
+	}
+	return std::max(-1.0, std::min(1.0, output));
+}
+
+PositionController::PositionController(CommandSender& sender, CameraConnection& connection) :
+	sender(sender), connection(connection), sent_zoom(0.f), control_rate(50.0), running(false)
+{
+	sent_pan_tilt[0] = sent_pan_tilt[1] = 0.f;
+}
+
+PositionController::~PositionController()
+{
+	Stop();
+}
+
+void PositionController::Start() {
+	if (running.exchange(true)) {
+		return;
+	}
+	worker = std::thread(&PositionController::Run, this);
+}
+
+void PositionController::Stop() {
+	running.store(false);
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void PositionController::SetTarget(double pan, double tilt, double zoom, const PIDGains& gains) {
+	const Settings new_settings = { pan, tilt, zoom, gains };
+	settings.Store(new_settings);
+}
+
+void PositionController::SetControlRate(double rate) {
+	control_rate.store(std::max(rate, 1.0), std::memory_order_relaxed);
+}
+
+void PositionController::Run() {
+	// Ticks land on time whatever TouchDesigner's frame rate is doing
+	RealtimeThreadScope realtime(ThreadPriority::ControlLoop);
+
+	PIDController pan, tilt, zoom;
+	// The last report stepped on, and whether the loop is steering from
+	// reports at all or waiting for them to come back
+	uint64_t last_reports = 0;
+	std::chrono::steady_clock::time_point reported_at;
+	bool tracking = false;
+	std::chrono::steady_clock::time_point next_tick = std::chrono::steady_clock::now();
+
+	// Whatever the head was doing, it starts from standstill
+	sent_pan_tilt[0] = sent_pan_tilt[1] = sent_zoom = NAN;
+	SendSpeeds(0.f, 0.f, 0.f);
+
+	while (running.load()) {
+		const double rate = control_rate.load(std::memory_order_relaxed);
+		std::this_thread::sleep_until(next_tick);
+
+		// Scheduled from the previous tick, not from now, so the loop doesn't drift
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		AdvanceTick(next_tick, GetTickPeriod(rate), now);
+
+		const CameraPosition position = connection.GetPosition();
+		const bool fresh = position.reports != last_reports && now - position.reported_at <= feedback_timeout;
+		if (!fresh) {
+			if (!tracking || now - reported_at > feedback_timeout) {
+				tracking = false;
+				pan.Reset();
+				tilt.Reset();
+				zoom.Reset();
+				SendSpeeds(0.f, 0.f, 0.f);
+			}
+			// The camera reports slower than the loop ticks. Stepping on the
+			// same position again would zero the derivative and add the stale
+			// error to the integral once more, so the speeds are held instead.
+			continue;
+		}
+
+		// Stepped by the time between the camera's reports, one control
+		// period for the first since there is nothing to go by
+		const double dt = tracking ?
+			std::max(std::chrono::duration<double>(position.reported_at - reported_at).count(), 1e-3) : 1.0 / rate;
+		last_reports = position.reports;
+		reported_at = position.reported_at;
+		tracking = true;
+
+		const Settings target = settings.Load();
+		SendSpeeds((float)pan.Update(target.pan, position.pan, dt, target.gains),
+			(float)tilt.Update(target.tilt, position.tilt, dt, target.gains),
+			(float)zoom.Update(target.zoom, position.zoom, dt, target.gains));
+	}
+
+	SendSpeeds(0.f, 0.f, 0.f);
+}
+
+void PositionController::SendSpeeds(float pan, float tilt, float zoom) {
+	// Unchanged speeds aren't sent again, the head keeps moving at the last one
+	if (pan != sent_pan_tilt[0] || tilt != sent_pan_tilt[1]) {
+		if (sender.SubmitControl(MakeCommand(PTZCommandType::PanTiltSpeed, pan, tilt))) {
+			sent_pan_tilt[0] = pan;
+			sent_pan_tilt[1] = tilt;
+		}
+	}
+	if (zoom != sent_zoom) {
+		if (sender.SubmitControl(MakeCommand(PTZCommandType::ZoomSpeed, zoom))) {
+			sent_zoom = zoom;
+		}
+	}
+}
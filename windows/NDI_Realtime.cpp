@@ -0,0 +1,27 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Timing of the control threads, which have to tick on time whatever
+*	TouchDesigner's frame rate is doing.
+*/
+
+#include "NDI_Realtime.h"
+
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+
+#pragma comment(lib, "winmm.lib")
+
+RealtimeThreadScope::RealtimeThreadScope(ThreadPriority priority)
+{
+	// The default 15.6 ms timer would make a 100 Hz loop tick at 64 Hz
+	timeBeginPeriod(1);
+	SetThreadPriority(GetCurrentThread(),
+		priority == ThreadPriority::ControlLoop ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_ABOVE_NORMAL);
+}
+
+RealtimeThreadScope::~RealtimeThreadScope()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+	timeEndPeriod(1);
+}
@@ -0,0 +1,155 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Receivers shared by every instance that targets the same camera, so ten
+*	panels driving one head still cost the camera a single NDI connection.
+*/
+
+#include "NDI_ReceiverPool.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+
+// How long a client keeps control of a shared camera after its last command
+static const std::chrono::milliseconds control_lease(500);
+
+SharedReceiver::SharedReceiver(NDIlib_recv_instance_t recv, const std::string& url) :
+	pNDI_recv(recv), url(url), controller_id(0),
+	tokens(HUGE_VAL), refilled_at(std::chrono::steady_clock::now()), paced_rate(0.0)
+{
+	feedback.Start(pNDI_recv);
+}
+
+SharedReceiver::~SharedReceiver()
+{
+	printf("Disconnecting from camera at %s\n", url.c_str());
+	feedback.Stop();
+	NDIlib_recv_destroy(pNDI_recv);
+}
+
+bool SharedReceiver::ClaimControl(uint32_t client_id) {
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(control_mutex);
+	if (controller_id != client_id && now < control_until) {
+		return false;
+	}
+	controller_id = client_id;
+	control_until = now + control_lease;
+	return true;
+}
+
+std::chrono::steady_clock::duration SharedReceiver::TakeToken(double rate, double burst, bool adaptive) {
+	if (rate <= 0.0 && !adaptive) {
+		std::lock_guard<std::mutex> lock(bucket_mutex);
+		paced_rate = 0.0;
+		return std::chrono::steady_clock::duration::zero();
+	}
+	burst = std::max(burst, 1.0);
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(bucket_mutex);
+	if (adaptive) {
+		// Paced by the same answers the feedback latency is timed from
+		CommandAnswer answers[CameraFeedback::MaxAnswers];
+		const int count = feedback.TakeAnswers(answers, CameraFeedback::MaxAnswers);
+		for (int i = 0; i < count; i++) {
+			if (answers[i].answered) {
+				rate_adapter.Answered(std::chrono::duration<double>(answers[i].latency).count(), now);
+			}
+			else {
+				rate_adapter.Unanswered();
+			}
+		}
+		rate = rate_adapter.GetRate(rate);
+	}
+	paced_rate = rate;
+
+	tokens = std::min(burst, tokens + std::chrono::duration<double>(now - refilled_at).count() * rate);
+	refilled_at = now;
+	if (tokens >= 1.0) {
+		tokens -= 1.0;
+		return std::chrono::steady_clock::duration::zero();
+	}
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>((1.0 - tokens) / rate));
+}
+
+double SharedReceiver::GetPacedRate() {
+	std::lock_guard<std::mutex> lock(bucket_mutex);
+	return paced_rate;
+}
+
+double SharedReceiver::GetCommandLatency() {
+	std::lock_guard<std::mutex> lock(bucket_mutex);
+	return rate_adapter.GetLatency();
+}
+
+std::shared_ptr<SharedReceiver> ReceiverPool::Acquire(const std::string& url, const std::string& name, bool receive_video) {
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	const std::pair<std::string, bool> key(url, receive_video);
+	std::shared_ptr<SharedReceiver> receiver = receivers[key].lock();
+	if (receiver) {
+		return receiver;
+	}
+
+	// Forget receivers whose last user has gone
+	for (auto it = receivers.begin(); it != receivers.end();) {
+		if (it->second.expired() && it->first != key) {
+			it = receivers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	return Create(url, name, receive_video);
+}
+
+std::shared_ptr<SharedReceiver> ReceiverPool::Reconnect(const std::shared_ptr<SharedReceiver>& stale,
+	const std::string& url, const std::string& name, bool receive_video) {
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	const std::pair<std::string, bool> key(url, receive_video);
+	std::shared_ptr<SharedReceiver> receiver = receivers[key].lock();
+	if (receiver && receiver != stale) {
+		return receiver;
+	}
+
+	// The stale receiver lives on until its last user has moved over
+	return Create(url, name, receive_video);
+}
+
+// Pool lock must be held
+std::shared_ptr<SharedReceiver> ReceiverPool::Create(const std::string& url, const std::string& name, bool receive_video) {
+	const std::pair<std::string, bool> key(url, receive_video);
+
+	NDIlib_source_t ndi_source = { name.c_str(), url.c_str() };
+
+	NDIlib_recv_create_v3_t NDI_recv_create_desc;
+	NDI_recv_create_desc.source_to_connect_to = ndi_source;
+	NDI_recv_create_desc.p_ndi_recv_name = "TD->NDI Camera Controller";
+	if (receive_video) {
+		NDI_recv_create_desc.bandwidth = NDIlib_recv_bandwidth_highest;
+		NDI_recv_create_desc.color_format = NDIlib_recv_color_format_UYVY_BGRA;
+	}
+	else {
+		// We never look at the frames, so don't make the SDK negotiate
+		// and decode the video stream or convert its colour format
+		NDI_recv_create_desc.bandwidth = NDIlib_recv_bandwidth_metadata_only;
+		NDI_recv_create_desc.color_format = NDIlib_recv_color_format_fastest;
+	}
+
+	NDIlib_recv_instance_t pNDI_recv = NDIlib_recv_create_v3(&NDI_recv_create_desc);
+	if (!pNDI_recv) {
+		printf("Error connecting to NDI source\n");
+		receivers.erase(key);
+		return nullptr;
+	}
+
+	std::shared_ptr<SharedReceiver> receiver = std::make_shared<SharedReceiver>(pNDI_recv, url);
+	receivers[key] = receiver;
+	return receiver;
+}
@@ -0,0 +1,56 @@
+/*
+* // NDI PTZ Camera controller \\
+*	Process-wide NDI runtime. Every CHOP instance holds a reference: the first
+*	one initialises NDI and starts the shared source finder, the last one
+*	tears both down again.
+*/
+
+#include "NDI_Runtime.h"
+
+#include <stdio.h>
+
+std::mutex NDIRuntime::instance_mutex;
+NDIRuntime* NDIRuntime::instance = nullptr;
+int NDIRuntime::ref_count = 0;
+
+NDIRuntime* NDIRuntime::Acquire() {
+	std::lock_guard<std::mutex> lock(instance_mutex);
+	if (ref_count++ == 0) {
+		instance = new NDIRuntime();
+	}
+	return instance;
+}
+
+void NDIRuntime::Release() {
+	std::lock_guard<std::mutex> lock(instance_mutex);
+	if (ref_count == 0) {
+		return;
+	}
+	if (--ref_count == 0) {
+		delete instance;
+		instance = nullptr;
+	}
+}
+
+NDIRuntime::NDIRuntime() : initialized(false)
+{
+	if (!NDIlib_initialize()) {
+		// Cannot run NDI. Most likely because the CPU is not sufficient (see SDK
+		// documentation). you can check this directly with a call to
+		// NDIlib_is_supported_CPU()
+		printf("Cannot run NDI.\n");
+		return;
+	}
+	initialized = true;
+
+	discovery.Start();
+}
+
+NDIRuntime::~NDIRuntime()
+{
+	// The finder has to go before the library it lives in
+	discovery.Stop();
+	if (initialized) {
+		NDIlib_destroy();
+	}
+}